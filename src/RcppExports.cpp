@@ -6,8 +6,8 @@
 using namespace Rcpp;
 
 // qatd_cpp_collocations_dev
-DataFrame qatd_cpp_collocations_dev(const List& texts_, const CharacterVector& types_, const unsigned int count_min, const IntegerVector sizes_, const std::string method, const double smoothing);
-RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_dev(SEXP texts_SEXP, SEXP types_SEXP, SEXP count_minSEXP, SEXP sizes_SEXP, SEXP methodSEXP, SEXP smoothingSEXP) {
+DataFrame qatd_cpp_collocations_dev(const List& texts_, const CharacterVector& types_, const unsigned int count_min, const IntegerVector sizes_, const std::string method, const double smoothing, const IntegerVector ignores_, const IntegerVector groups_, const unsigned int window, const bool verbose, const bool rank, const double compact_min);
+RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_dev(SEXP texts_SEXP, SEXP types_SEXP, SEXP count_minSEXP, SEXP sizes_SEXP, SEXP methodSEXP, SEXP smoothingSEXP, SEXP ignores_SEXP, SEXP groups_SEXP, SEXP windowSEXP, SEXP verboseSEXP, SEXP rankSEXP, SEXP compact_minSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -17,13 +17,166 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const IntegerVector >::type sizes_(sizes_SEXP);
     Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
     Rcpp::traits::input_parameter< const double >::type smoothing(smoothingSEXP);
-    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_dev(texts_, types_, count_min, sizes_, method, smoothing));
+    Rcpp::traits::input_parameter< const IntegerVector >::type ignores_(ignores_SEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type groups_(groups_SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const bool >::type rank(rankSEXP);
+    Rcpp::traits::input_parameter< const double >::type compact_min(compact_minSEXP);
+    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_dev(texts_, types_, count_min, sizes_, method, smoothing, ignores_, groups_, window, verbose, rank, compact_min));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// qatd_cpp_collocations_nominate
+List qatd_cpp_collocations_nominate(const List& texts_, const CharacterVector& types_, const unsigned int count_min, const IntegerVector sizes_, const IntegerVector ignores_, const bool verbose, const double compact_min);
+RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_nominate(SEXP texts_SEXP, SEXP types_SEXP, SEXP count_minSEXP, SEXP sizes_SEXP, SEXP ignores_SEXP, SEXP verboseSEXP, SEXP compact_minSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type texts_(texts_SEXP);
+    Rcpp::traits::input_parameter< const CharacterVector& >::type types_(types_SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type count_min(count_minSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type sizes_(sizes_SEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type ignores_(ignores_SEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const double >::type compact_min(compact_minSEXP);
+    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_nominate(texts_, types_, count_min, sizes_, ignores_, verbose, compact_min));
+    return rcpp_result_gen;
+END_RCPP
+}
+// qatd_cpp_collocations_boot
+List qatd_cpp_collocations_boot(const List& texts_, const CharacterVector& types_, const unsigned int count_min, const IntegerVector sizes_, const std::string method, const double smoothing, const IntegerVector ignores_, const NumericMatrix weights_, const NumericVector probs_);
+RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_boot(SEXP texts_SEXP, SEXP types_SEXP, SEXP count_minSEXP, SEXP sizes_SEXP, SEXP methodSEXP, SEXP smoothingSEXP, SEXP ignores_SEXP, SEXP weights_SEXP, SEXP probs_SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type texts_(texts_SEXP);
+    Rcpp::traits::input_parameter< const CharacterVector& >::type types_(types_SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type count_min(count_minSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type sizes_(sizes_SEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const double >::type smoothing(smoothingSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type ignores_(ignores_SEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix >::type weights_(weights_SEXP);
+    Rcpp::traits::input_parameter< const NumericVector >::type probs_(probs_SEXP);
+    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_boot(texts_, types_, count_min, sizes_, method, smoothing, ignores_, weights_, probs_));
+    return rcpp_result_gen;
+END_RCPP
+}
+// qatd_cpp_collocations_compare
+DataFrame qatd_cpp_collocations_compare(const List& texts_, const CharacterVector& types_, const unsigned int count_min, const IntegerVector sizes_, const std::string method, const double smoothing, const IntegerVector ignores_, const LogicalVector targets_);
+RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_compare(SEXP texts_SEXP, SEXP types_SEXP, SEXP count_minSEXP, SEXP sizes_SEXP, SEXP methodSEXP, SEXP smoothingSEXP, SEXP ignores_SEXP, SEXP targets_SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type texts_(texts_SEXP);
+    Rcpp::traits::input_parameter< const CharacterVector& >::type types_(types_SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type count_min(count_minSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type sizes_(sizes_SEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const double >::type smoothing(smoothingSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type ignores_(ignores_SEXP);
+    Rcpp::traits::input_parameter< const LogicalVector >::type targets_(targets_SEXP);
+    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_compare(texts_, types_, count_min, sizes_, method, smoothing, ignores_, targets_));
+    return rcpp_result_gen;
+END_RCPP
+}
+// qatd_cpp_collocations_compound
+List qatd_cpp_collocations_compound(const List& texts_, const CharacterVector& types_, const unsigned int count_min, const IntegerVector sizes_, const std::string method, const double smoothing, const double threshold, const IntegerVector ignores_, const String delim_);
+RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_compound(SEXP texts_SEXP, SEXP types_SEXP, SEXP count_minSEXP, SEXP sizes_SEXP, SEXP methodSEXP, SEXP smoothingSEXP, SEXP thresholdSEXP, SEXP ignores_SEXP, SEXP delim_SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type texts_(texts_SEXP);
+    Rcpp::traits::input_parameter< const CharacterVector& >::type types_(types_SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type count_min(count_minSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type sizes_(sizes_SEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const double >::type smoothing(smoothingSEXP);
+    Rcpp::traits::input_parameter< const double >::type threshold(thresholdSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type ignores_(ignores_SEXP);
+    Rcpp::traits::input_parameter< const String >::type delim_(delim_SEXP);
+    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_compound(texts_, types_, count_min, sizes_, method, smoothing, threshold, ignores_, delim_));
+    return rcpp_result_gen;
+END_RCPP
+}
+// qatd_cpp_collocations_read
+DataFrame qatd_cpp_collocations_read(const std::string file);
+RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_read(SEXP fileSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type file(fileSEXP);
+    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_read(file));
+    return rcpp_result_gen;
+END_RCPP
+}
+// qatd_cpp_collocations_sweep
+DataFrame qatd_cpp_collocations_sweep(const List& texts_, const CharacterVector& types_, const unsigned int count_min, const IntegerVector sizes_, const std::string method, const NumericVector smoothings_, const IntegerVector ignores_);
+RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_sweep(SEXP texts_SEXP, SEXP types_SEXP, SEXP count_minSEXP, SEXP sizes_SEXP, SEXP methodSEXP, SEXP smoothings_SEXP, SEXP ignores_SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type texts_(texts_SEXP);
+    Rcpp::traits::input_parameter< const CharacterVector& >::type types_(types_SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type count_min(count_minSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type sizes_(sizes_SEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const NumericVector >::type smoothings_(smoothings_SEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type ignores_(ignores_SEXP);
+    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_sweep(texts_, types_, count_min, sizes_, method, smoothings_, ignores_));
+    return rcpp_result_gen;
+END_RCPP
+}
+// qatd_cpp_collocations_targeted
+DataFrame qatd_cpp_collocations_targeted(const List& texts_, const CharacterVector& types_, const List& candidates_, const std::string method, const double smoothing, const IntegerVector ignores_, const bool verbose);
+RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_targeted(SEXP texts_SEXP, SEXP types_SEXP, SEXP candidates_SEXP, SEXP methodSEXP, SEXP smoothingSEXP, SEXP ignores_SEXP, SEXP verboseSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type texts_(texts_SEXP);
+    Rcpp::traits::input_parameter< const CharacterVector& >::type types_(types_SEXP);
+    Rcpp::traits::input_parameter< const List& >::type candidates_(candidates_SEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const double >::type smoothing(smoothingSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type ignores_(ignores_SEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_targeted(texts_, types_, candidates_, method, smoothing, ignores_, verbose));
+    return rcpp_result_gen;
+END_RCPP
+}
+// qatd_cpp_collocations_write
+double qatd_cpp_collocations_write(const List& texts_, const CharacterVector& types_, const unsigned int count_min, const IntegerVector sizes_, const std::string method, const double smoothing, const IntegerVector ignores_, const std::string file, const bool cells, const bool verbose);
+RcppExport SEXP _quanteda_collocationsdev_qatd_cpp_collocations_write(SEXP texts_SEXP, SEXP types_SEXP, SEXP count_minSEXP, SEXP sizes_SEXP, SEXP methodSEXP, SEXP smoothingSEXP, SEXP ignores_SEXP, SEXP fileSEXP, SEXP cellsSEXP, SEXP verboseSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type texts_(texts_SEXP);
+    Rcpp::traits::input_parameter< const CharacterVector& >::type types_(types_SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type count_min(count_minSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type sizes_(sizes_SEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const double >::type smoothing(smoothingSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector >::type ignores_(ignores_SEXP);
+    Rcpp::traits::input_parameter< const std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< const bool >::type cells(cellsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    rcpp_result_gen = Rcpp::wrap(qatd_cpp_collocations_write(texts_, types_, count_min, sizes_, method, smoothing, ignores_, file, cells, verbose));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_quanteda_collocationsdev_qatd_cpp_collocations_dev", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_dev, 6},
+    {"_quanteda_collocationsdev_qatd_cpp_collocations_boot", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_boot, 9},
+    {"_quanteda_collocationsdev_qatd_cpp_collocations_compare", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_compare, 8},
+    {"_quanteda_collocationsdev_qatd_cpp_collocations_compound", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_compound, 9},
+    {"_quanteda_collocationsdev_qatd_cpp_collocations_dev", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_dev, 12},
+    {"_quanteda_collocationsdev_qatd_cpp_collocations_nominate", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_nominate, 7},
+    {"_quanteda_collocationsdev_qatd_cpp_collocations_read", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_read, 1},
+    {"_quanteda_collocationsdev_qatd_cpp_collocations_sweep", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_sweep, 7},
+    {"_quanteda_collocationsdev_qatd_cpp_collocations_targeted", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_targeted, 7},
+    {"_quanteda_collocationsdev_qatd_cpp_collocations_write", (DL_FUNC) &_quanteda_collocationsdev_qatd_cpp_collocations_write, 10},
     {NULL, NULL, 0}
 };
 
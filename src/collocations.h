@@ -0,0 +1,572 @@
+#ifndef QUANTEDA_COLLOCATIONS // prevent redefining
+#define QUANTEDA_COLLOCATIONS
+
+#include "quanteda.h"
+#include <array>
+#include <numeric>
+#include <string>
+
+extern "C" {
+#include "loglin.h"
+}
+
+// maximum length of collocations
+const std::size_t COLLOCATIONS_MAX_SIZE = 8;
+
+/*
+ * Counts of n-grams are 32-bit by default. Compile with -DQUANTEDA_COLLOCATIONS_LARGE=1
+ * in PKG_CPPFLAGS for corpora of billions of tokens, so that counts and totals are
+ * 64-bit end to end and counts are returned as numeric vectors.
+ */
+#ifndef QUANTEDA_COLLOCATIONS_LARGE
+#define QUANTEDA_COLLOCATIONS_LARGE 0
+#endif
+
+#if QUANTEDA_COLLOCATIONS_LARGE
+typedef unsigned long long Count;
+typedef NumericVector CountVector;
+#else
+typedef unsigned int Count;
+typedef IntegerVector CountVector;
+#endif
+
+// 64-bit hash of type ids without the overflow of hash_ngram on large ids
+inline unsigned long long hash_ids(const unsigned int *ids, const std::size_t len){
+    unsigned long long seed = 0xcbf29ce484222325ULL;
+    for (std::size_t i = 0; i < len; i++) {
+        unsigned long long h = ids[i] + 0x9e3779b97f4a7c15ULL;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        seed = (seed ^ (h ^ (h >> 31))) * 0x100000001b3ULL;
+    }
+    return seed ^ (seed >> 32);
+}
+
+#if QUANTEDA_USE_TBB
+typedef tbb::atomic<Count> CountParam;
+typedef tbb::concurrent_vector<Count> CountParams;
+#else
+typedef Count CountParam;
+typedef std::vector<Count> CountParams;
+#endif
+
+// maximum number of n-grams for which slots of MapCounts are allocated in advance
+const std::size_t COLLOCATIONS_RESERVE_MAX = 1 << 20;
+
+// minimum number of tokens for which texts are compressed by CompactTexts in counting
+const std::size_t COLLOCATIONS_COMPACT_MIN = 1 << 25;
+
+// number of shards of MapCounts locked separately in the parallel mode
+#if QUANTEDA_USE_TBB
+const std::size_t COLLOCATIONS_SHARDS = 64;
+#else
+const std::size_t COLLOCATIONS_SHARDS = 1;
+#endif
+
+/*
+ * Flat open-addressing table of n-grams of a fixed length and their counts. Keys and
+ * counts are stored inline in arrays without allocation for each entry, and slots
+ * with zero counts are empty, so counts must be positive. The table is split into
+ * shards by hashes; a shard is locked while adding in the parallel mode and grows
+ * independently of the others.
+ */
+class MapCounts {
+    
+    struct Shard {
+        std::vector<unsigned int> keys;
+        std::vector<Count> values;
+        std::size_t mask = 0; // number of slots - 1
+        std::size_t size = 0;
+#if QUANTEDA_USE_TBB
+        tbb::spin_mutex mutex;
+#endif
+    };
+    
+    const std::size_t len_key;
+    std::vector<Shard> shards;
+    
+    Shard &shard_of(const unsigned long long h){
+        return shards[(h >> 40) & (COLLOCATIONS_SHARDS - 1)];
+    }
+    
+    // resize a shard to have at least len_slots slots
+    void rehash(Shard &shard, std::size_t len_slots){
+        std::size_t len = 16;
+        while (len < len_slots) len *= 2;
+        if (len <= shard.values.size()) return;
+        std::vector<unsigned int> keys(len * len_key);
+        std::vector<Count> values(len, 0);
+        std::size_t mask = len - 1;
+        for (std::size_t s = 0; s < shard.values.size(); s++) {
+            if (shard.values[s] == 0) continue;
+            const unsigned int *key = &shard.keys[s * len_key];
+            std::size_t t = hash_ids(key, len_key) & mask;
+            while (values[t] != 0) t = (t + 1) & mask;
+            std::copy(key, key + len_key, keys.begin() + t * len_key);
+            values[t] = shard.values[s];
+        }
+        shard.keys.swap(keys);
+        shard.values.swap(values);
+        shard.mask = mask;
+    }
+    
+public:
+    
+    MapCounts(const std::size_t len_key_): len_key(len_key_), shards(COLLOCATIONS_SHARDS){}
+    
+    // allocate slots for an expected number of n-grams
+    void reserve(const std::size_t len){
+        for (std::size_t k = 0; k < shards.size(); k++) {
+            rehash(shards[k], 2 * len / shards.size());
+        }
+    }
+    
+    // add a positive count to an n-gram; returns true if the n-gram is new
+    bool add(const quanteda::Ngram &ngram, const Count count){
+        const unsigned int *key = ngram.data();
+        unsigned long long h = hash_ids(key, len_key);
+        Shard &shard = shard_of(h);
+#if QUANTEDA_USE_TBB
+        tbb::spin_mutex::scoped_lock lock(shard.mutex);
+#endif
+        if (2 * (shard.size + 1) > shard.values.size()) rehash(shard, 2 * (shard.size + 1));
+        std::size_t s = h & shard.mask;
+        while (shard.values[s] != 0) {
+            if (std::equal(key, key + len_key, shard.keys.begin() + s * len_key)) {
+                shard.values[s] += count;
+                return false;
+            }
+            s = (s + 1) & shard.mask;
+        }
+        std::copy(key, key + len_key, shard.keys.begin() + s * len_key);
+        shard.values[s] = count;
+        shard.size++;
+        return true;
+    }
+    
+    std::size_t size() const {
+        std::size_t len = 0;
+        for (std::size_t k = 0; k < shards.size(); k++) len += shards[k].size;
+        return len;
+    }
+    
+    // call fun(ngram, count) for all the n-grams; not safe while adding
+    template <typename F>
+    void for_each(F fun) const {
+        quanteda::Ngram ngram(len_key);
+        for (std::size_t k = 0; k < shards.size(); k++) {
+            const Shard &shard = shards[k];
+            for (std::size_t s = 0; s < shard.values.size(); s++) {
+                if (shard.values[s] == 0) continue;
+                std::copy(shard.keys.begin() + s * len_key, shard.keys.begin() + (s + 1) * len_key, ngram.begin());
+                fun(ngram, shard.values[s]);
+            }
+        }
+    }
+};
+
+/*
+ * Texts compressed by variable-byte encoding of type ids ranked by frequency, so that
+ * frequent types take only one byte. Texts are blocks that start at offsets and are
+ * decoded separately, so they can be counted in parallel.
+ */
+struct CompactTexts {
+    std::vector<unsigned char> bytes;
+    std::vector<std::size_t> offsets;  // positions of texts in bytes
+    std::vector<unsigned int> lengths; // numbers of tokens in texts
+    std::vector<unsigned int> ids;     // type ids of ranks
+    
+    CompactTexts(){}
+    
+    // compress texts at positions in pos; len_types is larger than all the type ids
+    CompactTexts(const quanteda::Texts &texts, const std::vector<std::size_t> &pos,
+                 const std::size_t len_types){
+        
+        std::vector<std::size_t> freqs(len_types, 0);
+        for (std::size_t u = 0; u < pos.size(); u++) {
+            const quanteda::Text &text = texts[pos[u]];
+            for (std::size_t i = 0; i < text.size(); i++) freqs[text[i]]++;
+        }
+        ids.resize(len_types);
+        std::iota(ids.begin(), ids.end(), 0);
+        std::stable_sort(ids.begin(), ids.end(), [&freqs](unsigned int id1, unsigned int id2) {
+            return freqs[id1] > freqs[id2];
+        });
+        std::vector<unsigned int> ranks(len_types);
+        for (std::size_t r = 0; r < ids.size(); r++) ranks[ids[r]] = r;
+        
+        offsets.resize(pos.size());
+        lengths.resize(pos.size());
+        for (std::size_t u = 0; u < pos.size(); u++) {
+            const quanteda::Text &text = texts[pos[u]];
+            offsets[u] = bytes.size();
+            lengths[u] = text.size();
+            for (std::size_t i = 0; i < text.size(); i++) {
+                unsigned int r = ranks[text[i]];
+                while (r >= 0x80) {
+                    bytes.push_back((r & 0x7F) | 0x80);
+                    r >>= 7;
+                }
+                bytes.push_back(r);
+            }
+        }
+        bytes.shrink_to_fit();
+    }
+    
+    std::size_t size() const {
+        return offsets.size();
+    }
+    
+    void decode(const std::size_t u, quanteda::Text &text) const {
+        text.resize(lengths[u]);
+        const unsigned char *p = bytes.data() + offsets[u];
+        for (std::size_t i = 0; i < text.size(); i++) {
+            unsigned int r = 0, shift = 0;
+            while (*p & 0x80) {
+                r |= (unsigned int)(*p++ & 0x7F) << shift;
+                shift += 7;
+            }
+            r |= (unsigned int)(*p++) << shift;
+            text[i] = ids[r];
+        }
+    }
+};
+
+// convert counts to an R vector
+template <typename T>
+CountVector as_counts(const T &counts){
+    CountVector counts_(counts.size());
+    for (std::size_t i = 0; i < (std::size_t)counts.size(); i++) counts_[i] = counts[i];
+    return counts_;
+}
+
+/*
+ * Tables used in the scoring are generated at compile time for each size n, so
+ * that the kernels below are instantiated per size without run-time branching.
+ * Cells of the 2^n table are indexed by bits, 1 for matching and 0 for not
+ * matching at each position (see match_bit()).
+ */
+
+// compile-time integer sequence (std::index_sequence is only available in C++14)
+template <std::size_t... I> struct Seq {};
+template <std::size_t N, std::size_t... I> struct MakeSeq : MakeSeq<N - 1, N - 1, I...> {};
+template <std::size_t... I> struct MakeSeq<0, I...> { typedef Seq<I...> type; };
+
+// number of matching positions in a cell
+constexpr int count_bit(std::size_t b) {
+    return b == 0 ? 0 : (int)(b & 1) + count_bit(b >> 1);
+}
+
+// sign of a cell in the highest-order interaction, (-1)^(n - #(b))
+constexpr double sign_bit(std::size_t n, std::size_t b) {
+    return (n - count_bit(b)) % 2 == 0 ? 1.0 : -1.0;
+}
+
+// k-th element of the configurations of all (n-1)-way margins passed to loglin;
+// the c-th configuration omits the (n-c)-th variable and is terminated by zero
+// e.g. {1, 2, 0, 1, 3, 0, 2, 3, 0} for n = 3
+constexpr int config_bit(std::size_t n, std::size_t k) {
+    return k % n == n - 1 ? 0 : (k % n + 1 < n - k / n ? (int)(k % n + 1) : (int)(k % n + 2));
+}
+
+template <std::size_t N, typename S = typename MakeSeq<(1 << N)>::type> struct Signs;
+template <std::size_t N, std::size_t... B> struct Signs<N, Seq<B...> > {
+    static constexpr double value[sizeof...(B)] = {sign_bit(N, B)...};
+};
+template <std::size_t N, std::size_t... B>
+constexpr double Signs<N, Seq<B...> >::value[sizeof...(B)];
+
+template <std::size_t N, typename S = typename MakeSeq<(1 << N)>::type> struct Bits;
+template <std::size_t N, std::size_t... B> struct Bits<N, Seq<B...> > {
+    static constexpr int value[sizeof...(B)] = {count_bit(B)...};
+};
+template <std::size_t N, std::size_t... B>
+constexpr int Bits<N, Seq<B...> >::value[sizeof...(B)];
+
+template <std::size_t N, typename S = typename MakeSeq<N * N>::type> struct Configs;
+template <std::size_t N, std::size_t... K> struct Configs<N, Seq<K...> > {
+    static constexpr int value[sizeof...(K)] = {config_bit(N, K)...};
+};
+template <std::size_t N, std::size_t... K>
+constexpr int Configs<N, Seq<K...> >::value[sizeof...(K)];
+
+// 2^n table of a candidate, kept on the stack
+template <std::size_t N> using Table = std::array<double, 1 << N>;
+
+// return the matching pattern between two words at each position, 1 for matching, 0 for not matching.
+// for example, for 3-gram, bit = 000, 001, 010 ... 111 eg. 0-7
+template <std::size_t K> struct MatchBit {
+    static inline int value(const unsigned int *tokens1, const unsigned int *tokens2) {
+        return MatchBit<K - 1>::value(tokens1, tokens2) | ((tokens1[K - 1] == tokens2[K - 1]) << (K - 1));
+    }
+};
+template <> struct MatchBit<0> {
+    static inline int value(const unsigned int *tokens1, const unsigned int *tokens2) {
+        return 0;
+    }
+};
+
+template <std::size_t N>
+inline int match_bit(const std::vector<unsigned int> &tokens1,
+                     const std::vector<unsigned int> &tokens2){
+    return MatchBit<N>::value(tokens1.data(), tokens2.data()); // position dependent, bit=0:(2^n-1)
+}
+
+// association measures of a candidate computed from its 2^n table
+struct Measures {
+    double sgma = 0.0;
+    double lmda = 0.0;
+    double dice = 0.0;
+    double pmi = 0.0;
+    double logratio = 0.0;
+    double chi2 = 0.0;
+    double gensim = 0.0;
+    double lfmd = 0.0;
+    int ifault = 0;
+};
+
+// unigram subtuples from B&J algorithm -- lambda1
+template <std::size_t N>
+double sigma_uni(const Table<N> &counts){
+    double s = 0.0;
+    s += (N - 1) * (N - 1) / counts[0];
+    for (std::size_t b = 0; b < N; b++) {
+        s += 1.0 / counts[1 << b];
+    }
+    s += 1.0 / counts[(1 << N) - 1];
+    return std::sqrt(s);
+}
+
+template <std::size_t N>
+double lambda_uni(const Table<N> &counts){
+    double l = 0.0;
+    l += std::log(counts[0]) * (N - 1); // c0
+    for (std::size_t b = 0; b < N; b++) {  //c(b), #(b)=1
+        l -= std::log(counts[1 << b]);
+    }
+    l += std::log(counts[(1 << N) - 1]); //c(2^n-1)
+    return l;
+}
+
+// all subtuples from B&J algorithm
+template <std::size_t N>
+double sigma_all(const Table<N> &counts){
+    double s = 0.0;
+    for (std::size_t b = 0; b < (1 << N); b++) {
+        s += 1.0 / counts[b];
+    }
+    return std::sqrt(s);
+}
+
+template <std::size_t N>
+double lambda_all(const Table<N> &counts){
+    double l = 0.0;
+    for (std::size_t b = 0; b < (1 << N); b++) {
+        l += Signs<N>::value[b] * std::log(counts[b]);
+    }
+    return l;
+}
+
+//calculate dice coefficients
+// dice = 2*C(2^n-1)/sum(i=1:2^n-1)(#(i)*C(i)): #(i) counts number of digit'1'
+template <std::size_t N>
+double compute_dice(const Table<N> &counts){
+    double dice = 0.0;
+    for (std::size_t b = 1; b < (1 << N); b++) {
+        dice += Bits<N>::value[b] * counts[b];
+    }
+    dice = counts[(1 << N) - 1] / dice;  // smoothing has been applied when declaring counts_bit[]
+    return dice;
+}
+
+// fit the model without the highest-order interaction by iterative proportional fitting
+template <std::size_t N>
+int loglin_api(Table<N> &table, Table<N> &fit, const int iter = 20, const double eps = 0.1){
+
+    const int nvar = N;
+    const int ncon = N;
+    const int ntab = 1 << N;
+    const int nmar = (1 << (N - 1)) * N;
+    int nlast, ifault;
+
+    int locmar[N];
+    int dtab[N];
+    std::fill(dtab, dtab + N, 2);
+    int conf[N * N];
+    std::copy(Configs<N>::value, Configs<N>::value + N * N, conf);
+    double marg[nmar];
+    double u[ntab];
+    std::vector<double> dev(iter);
+
+    loglin_local(nvar, dtab, ncon, conf, ntab,
+                 table.data(), fit.data(), locmar, nmar, marg,
+                 ntab, u, eps, iter, &dev[0], &nlast, &ifault);
+    return ifault;
+}
+
+// compute association measures from observed counts
+template <std::size_t N>
+Measures score(Table<N> &counts_bit,
+               Table<N> &ec,
+               const std::string &method){
+
+    const std::size_t csize = 1 << N;
+    Measures m;
+
+    //B-J algorithm
+    if (method == "lambda1"){
+        m.sgma = sigma_uni<N>(counts_bit);
+        m.lmda = lambda_uni<N>(counts_bit);
+    } else if (method == "lambda" || method == "all") {
+        m.sgma = sigma_all<N>(counts_bit);
+        m.lmda = lambda_all<N>(counts_bit);
+    }
+
+    // Dice coefficient
+    m.dice = N * compute_dice<N>(counts_bit);
+
+    // expected counts: used in pmi, chi-sqaure, G2, gensim, LFMD
+    ec.fill(1.0);
+    if (N == 2){
+        double row_sum = counts_bit[0] + counts_bit[1] + counts_bit[2] + counts_bit[3];
+        ec[0] = (counts_bit[0] + counts_bit[1]) * (counts_bit[0] + counts_bit[2]) / row_sum;
+        ec[1] = (counts_bit[0] + counts_bit[1]) * (counts_bit[1] + counts_bit[3]) / row_sum;
+        ec[2] = (counts_bit[2] + counts_bit[3]) * (counts_bit[0] + counts_bit[2]) / row_sum;
+        ec[3] = (counts_bit[2] + counts_bit[3]) * (counts_bit[1] + counts_bit[3]) / row_sum;
+        m.ifault = 0;
+    } else {
+        m.ifault = loglin_api<N>(counts_bit, ec);
+    }
+
+    // calculate gensim score
+    // https://radimrehurek.com/gensim/models/phrases.html#gensim.models.phrases.Phrases
+    // gensim = (cnt(a, b) - min_count) * N / (cnt(a) * cnt(b))
+    //gensim[i] = (counts_bit[std::pow(2, n) - 1] - count_min) * nseqs/mc_product;
+
+    //LFMD
+    //see http://www.lrec-conf.org/proceedings/lrec2002/pdf/128.pdf for details about LFMD
+    //LFMD = log2(P(w1,w2)^2/P(w1)P(w2)) + log2(P(w1,w2))
+    m.lfmd = log2(pow(counts_bit[csize - 1], 2) / ec[csize - 1]) + log2(counts_bit[csize - 1]);
+
+    //pmi
+    m.pmi = log2(counts_bit[csize - 1] / ec[csize - 1]);
+
+    //logratio
+    double epsilon = 0.000000001; // to offset zero cell counts
+    for (std::size_t k = 0; k < csize; k++){
+        m.logratio += counts_bit[k] * log(counts_bit[k] / ec[k] + epsilon);
+    }
+    m.logratio *= 2;
+
+    //chi2
+    for (std::size_t k = 0; k < csize; k++){
+        m.chi2 += std::pow((counts_bit[k] - ec[k]), 2) / ec[k];
+    }
+    return m;
+}
+
+// convert a table of counts into a string such as "1.5_0.5_2.5_3.5"
+template <std::size_t N>
+std::string join_counts(const Table<N> &table){
+    std::ostringstream out;
+    out << std::setprecision(1) << std::fixed << std::showpoint << table[0];
+    for (std::size_t j = 1; j < (1 << N); j++) {
+        out << '_' << table[j];
+    }
+    return out.str();
+}
+
+// padding and ignored types are boundaries of collocations
+inline std::vector<bool> make_mask(const IntegerVector &ignores_, const std::size_t len_types){
+    std::vector<bool> mask(len_types + 1, false);
+    mask[0] = true;
+    for (std::size_t g = 0; g < (std::size_t)ignores_.size(); g++) {
+        if (ignores_[g] > 0 && ignores_[g] <= (int)len_types) mask[ignores_[g]] = true;
+    }
+    return mask;
+}
+
+inline void check_sizes(const std::vector<unsigned int> &sizes){
+    for (std::size_t m = 0; m < sizes.size(); m++) {
+        if (sizes[m] < 2 || COLLOCATIONS_MAX_SIZE < sizes[m])
+            throw std::range_error("Invalid size of collocations");
+    }
+}
+
+// show warnings on faults in the loglin fit, only once for each type
+inline void warn_ifault(const quanteda::IntParams &ifault, std::vector<int> &iwarning, Function &warningR){
+    for (std::size_t i = 0; i < ifault.size(); i++){
+        switch(ifault[i]) {
+        case 1:
+        case 2:
+            break;
+        case 3:
+            if (iwarning[1] == 0){
+                warningR("Warning: ipf algorithm did not converge for at least once"); 
+                iwarning[1] = 1;
+            }
+            break;
+        case 4:
+            if (iwarning[2] == 0){
+                warningR("Warning: incorrect specification of 'table' or 'start'"); 
+                iwarning[2] = 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// number of chunks of parallel loops between checks for user interrupts
+const std::size_t COLLOCATIONS_CHUNKS = 100;
+
+inline void check_interrupt_fn(void *dummy){
+    R_CheckUserInterrupt();
+}
+
+// true if the user interrupted; R_ToplevelExec() catches the interrupt so that it
+// does not jump out of C++ code
+inline bool is_interrupted(){
+    return R_ToplevelExec(check_interrupt_fn, NULL) == FALSE;
+}
+
+// state of a long run shared by its phases
+struct Progress {
+    bool verbose;
+    bool cancelled;
+    Progress(const bool verbose_ = false): verbose(verbose_), cancelled(false){}
+};
+
+/*
+ * Run a worker over [begin, end) in chunks. The main thread checks for user interrupts
+ * before each chunk and reports progress after it, so the workers are not slowed down
+ * and a run whose last chunk has finished is never discarded.
+ * Returns false if the run was cancelled by the user.
+ */
+template <typename W>
+bool run_chunks(W &worker, const std::size_t begin, const std::size_t end,
+                Progress &progress, const std::string &phase){
+
+    if (progress.cancelled) return false;
+    std::size_t len = end - begin;
+    std::size_t len_chunk = std::max(len / COLLOCATIONS_CHUNKS, (std::size_t)1);
+    for (std::size_t b = begin; b < end; b += len_chunk) {
+        if (is_interrupted()) {
+            progress.cancelled = true;
+            break;
+        }
+        std::size_t e = std::min(b + len_chunk, end);
+#if QUANTEDA_USE_TBB
+        parallelFor(b, e, worker);
+#else
+        worker(b, e);
+#endif
+        if (progress.verbose)
+            Rcout << "\r" << phase << ": " << (100 * (e - begin) / len) << "%" << std::flush;
+    }
+    if (progress.verbose && len > 0) Rcout << std::endl;
+    return !progress.cancelled;
+}
+
+#endif
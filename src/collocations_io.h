@@ -0,0 +1,235 @@
+#ifndef QUANTEDA_COLLOCATIONS_IO // prevent redefining
+#define QUANTEDA_COLLOCATIONS_IO
+
+#include "collocations.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Columnar binary file of scored collocations. All the values are in the native byte
+ * order (little-endian on the supported platforms).
+ *
+ * header:
+ *   char[4]  magic "QCOL"
+ *   uint32   version
+ *   uint32   number of columns, followed by each column's
+ *              uint8  type of values (COLUMN_UINT32, COLUMN_UINT64 or COLUMN_DOUBLE)
+ *              uint8  number of values in a row (COLUMN_SCALAR, COLUMN_SIZE for n or
+ *                     COLUMN_CELLS for 2^n values of a collocation of size n)
+ *              uint16 length of the name and its bytes
+ *   uint64   number of types, followed by each type's uint32 length and UTF-8 bytes;
+ *            the type ids in "ngram" are 1-based positions in this dictionary
+ * chunks, repeated until the end of the file:
+ *   uint32   size of the collocations in the chunk
+ *   uint64   number of rows
+ *   values of the columns in the order of the header, one column after another
+ */
+const char COLUMNS_MAGIC[4] = {'Q', 'C', 'O', 'L'};
+const uint32_t COLUMNS_VERSION = 1;
+
+enum ColumnType : uint8_t { COLUMN_UINT32 = 1, COLUMN_UINT64 = 2, COLUMN_DOUBLE = 3 };
+enum ColumnShape : uint8_t { COLUMN_SCALAR = 0, COLUMN_SIZE = 1, COLUMN_CELLS = 2 };
+
+// number of rows estimated and written at once
+const std::size_t COLUMNS_CHUNK_ROWS = 1 << 16;
+
+struct Column {
+    std::string name;
+    uint8_t type;
+    uint8_t shape;
+};
+
+inline std::size_t column_width(const Column &column, const std::size_t size){
+    if (column.shape == COLUMN_SIZE) return size;
+    if (column.shape == COLUMN_CELLS) return (std::size_t)1 << size;
+    return 1;
+}
+
+inline std::size_t column_bytes(const Column &column){
+    return column.type == COLUMN_UINT32 ? 4 : 8;
+}
+
+// columns of a file in their order
+inline std::vector<Column> make_columns(const bool cells){
+    std::vector<Column> columns = {
+        {"ngram", COLUMN_UINT32, COLUMN_SIZE},
+        {"count", COLUMN_UINT64, COLUMN_SCALAR},
+        {"lambda", COLUMN_DOUBLE, COLUMN_SCALAR},
+        {"sigma", COLUMN_DOUBLE, COLUMN_SCALAR},
+        {"G2", COLUMN_DOUBLE, COLUMN_SCALAR},
+        {"chi2", COLUMN_DOUBLE, COLUMN_SCALAR},
+        {"pmi", COLUMN_DOUBLE, COLUMN_SCALAR},
+        {"LFMD", COLUMN_DOUBLE, COLUMN_SCALAR}
+    };
+    if (cells) columns.push_back({"cells", COLUMN_DOUBLE, COLUMN_CELLS});
+    return columns;
+}
+
+// a chunk of scored collocations of the same size
+struct ColumnChunk {
+    std::vector<unsigned int> ngrams; // type ids, size values in a row
+    std::vector<uint64_t> cs;
+    std::vector<Measures> measures;
+    std::vector<double> cells;        // observed counts, 2^size values in a row
+};
+
+// append chunks of collocations to a file without keeping them in memory
+class ColumnWriter {
+    std::ofstream out;
+    std::vector<Column> columns;
+    std::vector<double> buffer;
+
+    template <typename T>
+    void put(const T &value){
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void put(const std::vector<T> &values){
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void put_measure(const ColumnChunk &chunk, double Measures::*field){
+        buffer.resize(chunk.measures.size());
+        for (std::size_t i = 0; i < chunk.measures.size(); i++)
+            buffer[i] = chunk.measures[i].*field;
+        put(buffer);
+    }
+
+public:
+    ColumnWriter(const std::string &file, const CharacterVector &types_, const bool cells):
+        out(file.c_str(), std::ios::binary | std::ios::trunc), columns(make_columns(cells)){
+
+        if (!out) throw std::runtime_error("Cannot open " + file);
+        out.write(COLUMNS_MAGIC, sizeof(COLUMNS_MAGIC));
+        put(COLUMNS_VERSION);
+        put((uint32_t)columns.size());
+        for (std::size_t j = 0; j < columns.size(); j++) {
+            put(columns[j].type);
+            put(columns[j].shape);
+            put((uint16_t)columns[j].name.size());
+            out.write(columns[j].name.data(), columns[j].name.size());
+        }
+        put((uint64_t)types_.size());
+        for (std::size_t g = 0; g < (std::size_t)types_.size(); g++) {
+            std::string type = as<std::string>(types_[g]);
+            put((uint32_t)type.size());
+            out.write(type.data(), type.size());
+        }
+    }
+
+    void write(const ColumnChunk &chunk, const unsigned int size){
+        put((uint32_t)size);
+        put((uint64_t)chunk.cs.size());
+        put(chunk.ngrams);
+        put(chunk.cs);
+        put_measure(chunk, &Measures::lmda);
+        put_measure(chunk, &Measures::sgma);
+        put_measure(chunk, &Measures::logratio);
+        put_measure(chunk, &Measures::chi2);
+        put_measure(chunk, &Measures::pmi);
+        put_measure(chunk, &Measures::lfmd);
+        if (columns.back().name == "cells") put(chunk.cells);
+        if (!out) throw std::runtime_error("Cannot write to the file");
+    }
+
+    void close(){
+        out.close();
+        if (out.fail()) throw std::runtime_error("Cannot write to the file");
+    }
+};
+
+// read-only view of a file, memory-mapped where supported
+class MappedFile {
+    const char *data_ = NULL;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+
+public:
+    MappedFile(const std::string &file){
+#ifdef _WIN32
+        std::ifstream in(file.c_str(), std::ios::binary);
+        if (!in) throw std::runtime_error("Cannot open " + file);
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = buffer.data();
+        size_ = buffer.size();
+#else
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open " + file);
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot open " + file);
+        }
+        size_ = st.st_size;
+        if (size_ > 0) {
+            void *p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot map " + file);
+            }
+            data_ = static_cast<const char*>(p);
+        }
+        ::close(fd); // the mapping stays valid
+#endif
+    }
+
+    ~MappedFile(){
+#ifndef _WIN32
+        if (data_) munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char *data() const { return data_; }
+    std::size_t size() const { return size_; }
+};
+
+// sequential reader of a mapped file that checks the bounds
+class ColumnCursor {
+    const char *data;
+    std::size_t size;
+    std::size_t pos = 0;
+
+public:
+    ColumnCursor(const MappedFile &file): data(file.data()), size(file.size()){}
+
+    bool done() const { return pos == size; }
+    std::size_t remaining() const { return size - pos; }
+
+    // pointer to the next len bytes
+    const char *skip(const std::size_t len){
+        if (len > size - pos) throw std::range_error("Invalid or truncated file");
+        const char *p = data + pos;
+        pos += len;
+        return p;
+    }
+
+    // pointer to the next len values of width bytes; len is checked before it is 
+    // multiplied, since it is read from the file and the product may overflow
+    const char *skip(const uint64_t len, const std::size_t width){
+        if (width > 0 && len > (size - pos) / width) throw std::range_error("Invalid or truncated file");
+        return skip(len * width);
+    }
+
+    template <typename T>
+    T get(){
+        T value;
+        std::memcpy(&value, skip(sizeof(T)), sizeof(T));
+        return value;
+    }
+};
+
+#endif
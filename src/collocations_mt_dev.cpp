@@ -1,164 +1,270 @@
-#include "quanteda.h"
-#include <bitset>
-#include <string>
+#include "collocations.h"
+#include "collocations_io.h"
 using namespace quanteda;
 
-extern "C" {
-#include "loglin.h"
-}
-
-// return the matching pattern between two words at each position, 0 for matching, 1 for not matching.
-// for example, for 3-gram, bit = 000, 001, 010 ... 111 eg. 0-7
-int match_bit(const std::vector<unsigned int> &tokens1, 
-              const std::vector<unsigned int> &tokens2){
-    
-    std::size_t len1 = tokens1.size();
-    std::size_t len2 = tokens2.size();
-    int bit = 0;
-    for (std::size_t i = 0; i < len1 && i < len2; i++) {
-        if (tokens1[i] == tokens2[i]) bit += std::pow(2, i); // position dependent, bit=0:(2^n-1)
+//************************//
+// offsets of tokens in windows of a size; if window is larger than size, all the 
+// combinations of positions in the window are used to count non-adjacent n-grams
+Ngrams make_patterns(const unsigned int size, const unsigned int window){
+    Ngrams patterns;
+    Ngram offsets(size);
+    std::iota(offsets.begin(), offsets.end(), 0);
+    patterns.push_back(offsets);
+    if (window <= size) return patterns;
+    while (true) {
+        std::size_t k = size - 1;
+        while (k > 0 && offsets[k] == window - size + k) k--;
+        if (k == 0) break;
+        offsets[k]++;
+        for (std::size_t l = k + 1; l < size; l++) offsets[l] = offsets[l - 1] + 1;
+        patterns.push_back(offsets);
     }
-    return bit;
+    return patterns;
 }
 
-// unigram subtuples from B&J algorithm -- lambda1
-double sigma_uni(const std::vector<double> &counts, const std::size_t ntokens){
-    double s = 0.0;
-    s += std::pow(ntokens - 1, 2) / counts[0];
-    for (std::size_t b = 0; b < ntokens; b++) {
-        s += 1.0 / counts[std::pow(2, b)];
+// numbers of tokens skipped between the tokens of a pattern (e.g. "0_2")
+std::string join_gaps(const Ngram &offsets){
+    std::string gaps;
+    for (std::size_t k = 1; k < offsets.size(); k++) {
+        if (k > 1) gaps += '_';
+        gaps += std::to_string(offsets[k] - offsets[k - 1] - 1);
     }
-    s += 1.0 / counts[std::pow(2, ntokens) - 1];
-    return std::sqrt(s);
+    return gaps;
 }
 
-double lambda_uni(const std::vector<double> &counts, const std::size_t ntokens){
-    double l = 0.0;
-    l += std::log(counts[0]) * (ntokens - 1); // c0
-    for (std::size_t b = 0; b < ntokens; b++) {  //c(b), #(b)=1
-        l -= std::log(counts[std::pow(2, b)]);
+// count n-grams in a text; windows that contain a masked (padding, punctuation or 
+// boundary) token at the positions of a pattern are not candidates, so they are stored 
+// separately in counts_part with the masked positions set to zero to keep their 
+// contribution to the marginals. Tokens skipped in gaps are not part of the n-grams, 
+// so they can be masked. The group of the text and the pattern of the window are 
+// appended to the n-grams to count them by groups and patterns, and the counts are 
+// multiplied by the number of identical texts in the group.
+void counts(const Text &text,
+            const unsigned int group,
+            const unsigned int weight,
+            MapCounts &counts_seq,
+            MapCounts &counts_part,
+            const unsigned int &size,
+            const Ngrams &patterns,
+            const std::vector<bool> &mask){
+    
+    std::size_t len_text = text.size();
+    if (len_text < size) return; // do nothing with short or empty text
+    
+    std::size_t len_patterns = patterns.size();
+    Ngram ngram(size + 1); // overwritten for each window
+    for (std::size_t i = 0; i + size <= len_text; i++) {
+        for (std::size_t q = 0; q < len_patterns; q++) {
+            const Ngram &offsets = patterns[q];
+            if (i + offsets[size - 1] >= len_text) continue;
+            ngram[size] = group * len_patterns + q;
+            bool masked = false;
+            for (std::size_t k = 0; k < size; k++) {
+                unsigned int id = text[i + offsets[k]];
+                if (mask[id]) {
+                    masked = true;
+                    id = 0;
+                }
+                ngram[k] = id;
+            }
+            if (masked) {
+                counts_part.add(ngram, weight);
+            } else {
+                counts_seq.add(ngram, weight);
+            }
+        }
     }
-    l += std::log(counts[std::pow(2, ntokens) - 1]); //c(2^n-1)
-    return l;
 }
 
-// all subtuples from B&J algorithm
-double sigma_all(const std::vector<double> &counts){
-    const std::size_t n = counts.size();
-    double s = 0.0;
+struct counts_mt : public Worker{
     
-    for (std::size_t b = 0; b < n; b++) {
-        s += 1.0 / counts[b];
-    }
+    Texts &texts;
+    const std::vector<unsigned int> &groups;
+    const std::vector<std::size_t> &uniques;
+    const std::vector<unsigned int> &weights;
+    MapCounts &counts_seq;
+    MapCounts &counts_part;
+    const unsigned int &len;
+    const Ngrams &patterns;
+    const std::vector<bool> &mask;
     
-    return std::sqrt(s);
-}
+    counts_mt(Texts &texts_, const std::vector<unsigned int> &groups_, const std::vector<std::size_t> &uniques_, 
+              const std::vector<unsigned int> &weights_, MapCounts &counts_seq_, MapCounts &counts_part_, 
+              const unsigned int &len_, const Ngrams &patterns_, const std::vector<bool> &mask_):
+        texts(texts_), groups(groups_), uniques(uniques_), weights(weights_), counts_seq(counts_seq_), 
+        counts_part(counts_part_), len(len_), patterns(patterns_), mask(mask_){}
+    
+    void operator()(std::size_t begin, std::size_t end){
+        for (std::size_t u = begin; u < end; u++){
+            std::size_t h = uniques[u];
+            counts(texts[h], groups[h], weights[u], counts_seq, counts_part, len, patterns, mask);
+        }
+    }
+};
 
-double lambda_all(const std::vector<double> &counts, const std::size_t ntokens){
-    const std::size_t n = counts.size();
+// count n-grams in unique texts decoded from the compressed stream
+struct counts_compact_mt : public Worker{
     
-    double l = 0.0;
+    const CompactTexts &compact;
+    const std::vector<unsigned int> &groups;
+    const std::vector<std::size_t> &uniques;
+    const std::vector<unsigned int> &weights;
+    MapCounts &counts_seq;
+    MapCounts &counts_part;
+    const unsigned int &len;
+    const Ngrams &patterns;
+    const std::vector<bool> &mask;
     
-    for (std::size_t b = 0; b < n; b++) {  //c(b), #(b)=1
-        std::bitset<8> bitb(b);
-        l += std::pow(-1, ntokens - bitb.count()) * std::log(counts[b]);
-    }
+    counts_compact_mt(const CompactTexts &compact_, const std::vector<unsigned int> &groups_, const std::vector<std::size_t> &uniques_, 
+                      const std::vector<unsigned int> &weights_, MapCounts &counts_seq_, MapCounts &counts_part_, 
+                      const unsigned int &len_, const Ngrams &patterns_, const std::vector<bool> &mask_):
+        compact(compact_), groups(groups_), uniques(uniques_), weights(weights_), counts_seq(counts_seq_), 
+        counts_part(counts_part_), len(len_), patterns(patterns_), mask(mask_){}
     
-    return l;
-}
+    void operator()(std::size_t begin, std::size_t end){
+        Text text;
+        for (std::size_t u = begin; u < end; u++){
+            compact.decode(u, text);
+            counts(text, groups[uniques[u]], weights[u], counts_seq, counts_part, len, patterns, mask);
+        }
+    }
+};
 
-//calculate dice coefficients
-// dice = 2*C(2^n-1)/sum(i=1:2^n-1)(#(i)*C(i)): #(i) counts number of digit'1'
-double compute_dice(const std::vector<double> &counts){
-    double dice = 0.0;
-    const std::size_t n = counts.size();
-    for (std::size_t b = 1; b < n; b++) {  //c(b), #(b)=1
-        std::bitset<8> bitb(b);
-        dice += bitb.count() * counts[b]; 
+// hash of a text and its group to find identical texts
+inline std::size_t hash_text(const Text &text, const unsigned int group){
+    std::size_t seed = std::hash<unsigned int>()(group);
+    for (std::size_t i = 0; i < text.size(); i++) {
+        seed ^= std::hash<unsigned int>()(text[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
     }
-    //Rcout<<"counts[n-1]="<<counts[n-1]<<"dice="<<dice<<std::endl;
-    dice = counts[n-1]/(dice);  // smoothing has been applied when declaring counts_bit[]
-    return dice;
+    return seed;
 }
 
-
-int loglin_api(std::vector<double> &table, std::vector<double> &fit, const std::size_t ntokens, const int iter = 20, const double eps = 0.1){
-    int nvar = ntokens;
-    int ncon = ntokens;
-    int ntab = table.size();
-    int nmar = std::pow(2, ntokens - 1) * ntokens;
-    int nlast, ifault;
-    
-    std::vector<int> locmar(ncon);
-    std::vector<double> marg(nmar);
-    std::vector<double> u(ntab);
-    std::vector<double> dev(iter);
-    std::vector<int> dtab(ntokens, 2);
-    std::vector<int> conf(ntokens * ntokens);
-    if (ntokens == 3){
-        static const int arr[] = {1, 2, 0, 1, 3, 0, 2, 3, 0};
-        conf.assign(arr, arr + sizeof(arr) / sizeof(int));
-    } else if (ntokens == 4){
-        static const int arr4[] = {1, 2, 3, 0, 1, 2, 4, 0, 1, 3, 4, 0, 2, 3, 4, 0};
-        conf.assign(arr4, arr4 + sizeof(arr4) / sizeof(int));
-    } else if (ntokens == 5){
-        static const int arr5[] = {1, 2, 3, 4, 0, 1, 2, 3, 5, 0, 1, 3, 4, 5, 0, 2, 3, 4, 5, 0};
-        conf.assign(arr5, arr5 + sizeof(arr5) / sizeof(int));
-    } else {
-        throw "ntokens is out of range ";   
-    }
-    
+struct hash_texts_mt : public Worker{
     
-    loglin_local(nvar, &dtab[0], ncon, &conf[0], ntab,
-                 &table[0], &fit[0], &locmar[0], nmar, &marg[0],
-                 ntab, &u[0], eps, iter, &dev[0], &nlast, &ifault);
+    Texts &texts;
+    const std::vector<unsigned int> &groups;
+    std::vector<std::size_t> &hashes;
     
-    return ifault;
-    
-}
-//************************//
-void counts(Text text,
-            MapNgrams &counts_seq,
-            const unsigned int &size){
+    hash_texts_mt(Texts &texts_, const std::vector<unsigned int> &groups_, std::vector<std::size_t> &hashes_):
+        texts(texts_), groups(groups_), hashes(hashes_){}
     
+    void operator()(std::size_t begin, std::size_t end){
+        for (std::size_t h = begin; h < end; h++){
+            hashes[h] = hash_text(texts[h], groups[h]);
+        }
+    }
+};
+
+// collapse identical texts in the same group to the first of them, recording the
+// number of the texts as its weight
+void collapse_texts(Texts &texts,
+                    const std::vector<unsigned int> &groups,
+                    std::vector<std::size_t> &uniques,
+                    std::vector<unsigned int> &weights){
     
-    if (text.size() == 0) return; // do nothing with empty text
-    text.push_back(0); // add padding to include last words
+    std::vector<std::size_t> hashes(texts.size());
+#if QUANTEDA_USE_TBB
+    hash_texts_mt hash_mt(texts, groups, hashes);
+    parallelFor(0, texts.size(), hash_mt);
+#else
+    for (std::size_t h = 0; h < texts.size(); h++) {
+        hashes[h] = hash_text(texts[h], groups[h]);
+    }
+#endif
     
-    std::size_t len_text = text.size();
-    for (std::size_t i = 0; i <= len_text; i++) {
-        //Rcout << "Size" << size << "\n";
-        if (i + size < len_text) {
-            //if (std::find(text.begin() + i, text.begin() + i + size, 0) == text.begin() + i + size) {
-            // dev::print_ngram(text_sub);
-            Text text_sub(text.begin() + i, text.begin() + i + size);
-            counts_seq[text_sub]++;
-            // }
+    // texts with the same hash are compared to avoid collision
+    std::unordered_multimap<std::size_t, std::size_t> map_uniques; // hash to position in uniques
+    for (std::size_t h = 0; h < texts.size(); h++) {
+        bool found = false;
+        auto range = map_uniques.equal_range(hashes[h]);
+        for (auto it = range.first; it != range.second; ++it) {
+            std::size_t u = it -> second;
+            if (groups[uniques[u]] == groups[h] && texts[uniques[u]] == texts[h]) {
+                weights[u]++;
+                found = true;
+                break;
+            }
         }
+        if (found) continue;
+        map_uniques.insert(std::make_pair(hashes[h], uniques.size()));
+        uniques.push_back(h);
+        weights.push_back(1);
     }
 }
 
-struct counts_mt : public Worker{
+// add counts of sequences in [begin, end) to the cells of a candidate's table
+template <std::size_t N>
+void count_table(const Ngram &seq,
+                 const VecNgrams &seqs,
+                 const CountParams &cs,
+                 const std::size_t begin,
+                 const std::size_t end,
+                 Table<N> &counts_bit){
+    for (std::size_t j = begin; j < end; j++) {
+        int bit;
+        bit = match_bit<N>(seq, seqs[j]);
+        counts_bit[bit] += cs[j];
+    }
+}
+
+// occurrences of types at each position of bigrams in each group of sequences; the table of
+// a bigram is determined by them and its own count, so it is computed without scanning
+// all the sequences in its group
+struct Marginals {
+    std::unordered_map<unsigned long long, double> counts; // keyed by group, position and type
+    std::vector<double> totals; // total counts of sequences in groups
     
-    Texts texts;
-    MapNgrams &counts_seq;
-    const unsigned int &len;
+    static inline unsigned long long key(const std::size_t g, const std::size_t b, const unsigned int type){
+        return ((unsigned long long)(g * 2 + b) << 32) | type;
+    }
     
-    counts_mt(Texts texts_, MapNgrams &counts_seq_, const unsigned int &len_):
-        texts(texts_), counts_seq(counts_seq_), len(len_){}
+    inline double get(const std::size_t g, const std::size_t b, const unsigned int type) const {
+        auto it = counts.find(key(g, b, type));
+        return it == counts.end() ? 0.0 : it -> second;
+    }
+};
+
+void count_marginals(const VecNgrams &seqs,
+                     const CountParams &cs,
+                     const std::vector<std::size_t> &starts,
+                     Marginals &marginals){
     
-    void operator()(std::size_t begin, std::size_t end){
-        for (std::size_t h = begin; h < end; h++){
-            counts(texts[h], counts_seq, len);
+    std::size_t len_keys = starts.size() - 1;
+    marginals.counts.reserve(std::min(seqs.size(), COLLOCATIONS_RESERVE_MAX));
+    marginals.totals.assign(len_keys, 0.0);
+    for (std::size_t g = 0; g < len_keys; g++) {
+        for (std::size_t j = starts[g]; j < starts[g + 1]; j++) {
+            marginals.counts[Marginals::key(g, 0, seqs[j][0])] += cs[j];
+            marginals.counts[Marginals::key(g, 1, seqs[j][1])] += cs[j];
+            marginals.totals[g] += cs[j];
         }
     }
-};
+}
+
+// add counts to the cells of a bigram's table from the marginals, which gives the 
+// same table as count_table<2>()
+template <std::size_t N>
+void count_table_marginals(const Ngram &seq,
+                           const double count,
+                           const Marginals &marginals,
+                           Table<N> &counts_bit){
+    std::size_t g = seq[N];
+    double m0 = marginals.get(g, 0, seq[0]);
+    double m1 = marginals.get(g, 1, seq[1]);
+    counts_bit[0] += marginals.totals[g] - m0 - m1 + count;
+    counts_bit[1] += m0 - count;
+    counts_bit[2] += m1 - count;
+    counts_bit[3] += count;
+}
 
+template <std::size_t N>
 void estimates(std::size_t i,
-               VecNgrams &seqs_np,  // seqs without padding
-               IntParams &cs_np,
+               VecNgrams &seqs_np,  // candidates without masked tokens
+               CountParams &cs_np,
                VecNgrams &seqs,
-               IntParams &cs, 
+               CountParams &cs, 
+               const std::vector<std::size_t> &starts, // positions of groups in seqs
+               const Marginals &marginals, // only for bigrams
                DoubleParams &sgma, 
                DoubleParams &lmda, 
                DoubleParams &dice,
@@ -169,111 +275,50 @@ void estimates(std::size_t i,
                DoubleParams &lfmd,
                IntParams &ifault,
                const std::string &method,
-               const int &count_min,
+               const unsigned int &count_min,
                const double nseqs,
                const double smoothing,
                StringParams &ob_n,
                StringParams &exp_n){
     
-    std::size_t n = seqs_np[i].size(); //n=2:5, seqs
-    if (n == 1) return; // ignore single words
     if (cs_np[i] < count_min) return;
     //output counts
-    std::vector<double> counts_bit(std::pow(2, n), smoothing);// use 1/2 as smoothing
-    for (std::size_t j = 0; j < seqs.size(); j++) {
-        //if (i == j) continue; // do not compare with itself
-        
-        int bit;
-        bit = match_bit(seqs_np[i], seqs[j]);
-        counts_bit[bit] += cs[j];
+    Table<N> counts_bit;
+    counts_bit.fill(smoothing);// use 1/2 as smoothing
+    std::size_t g = seqs_np[i][N]; // group is the last element
+    if (N == 2) {
+        count_table_marginals<N>(seqs_np[i], cs_np[i], marginals, counts_bit);
+    } else {
+        count_table<N>(seqs_np[i], seqs, cs, starts[g], starts[g + 1], counts_bit);
     }
     //counts_bit[std::pow(2, n)-1]  += cs_np[i];//  c(2^n-1) += number of itself  
     
-    //B-J algorithm    
-    if (method == "lambda1"){
-        sgma[i] = sigma_uni(counts_bit, n);
-        lmda[i] = lambda_uni(counts_bit, n);
-    } else if (method == "lambda" || method == "all") {
-        sgma[i] = sigma_all(counts_bit);
-        lmda[i] = lambda_all(counts_bit, n);
-    }
+    Table<N> ec;
+    Measures m = score<N>(counts_bit, ec, method);
+    sgma[i] = m.sgma;
+    lmda[i] = m.lmda;
+    dice[i] = m.dice;
+    pmi[i] = m.pmi;
+    logratio[i] = m.logratio;
+    chi2[i] = m.chi2;
+    gensim[i] = m.gensim;
+    lfmd[i] = m.lfmd;
+    ifault[i] = m.ifault;
     
-    if (method != "lambda" || method != "lambda1"){
-        // Dice coefficient
-        dice[i] = n * compute_dice(counts_bit);
-        
-        // expected counts: used in pmi, chi-sqaure, G2, gensim, LFMD
-        std::size_t csize = pow(2, n);  
-        std::vector<double> ec(csize, 1.0);
-        if ( n == 2){
-            double row_sum = counts_bit[0] + counts_bit[1] + counts_bit[2] + counts_bit[3];
-            ec[0] = (counts_bit[0] + counts_bit[1]) * (counts_bit[0] + counts_bit[2]) / row_sum;
-            ec[1] = (counts_bit[0] + counts_bit[1]) * (counts_bit[1] + counts_bit[3]) / row_sum;
-            ec[2] = (counts_bit[2] + counts_bit[3]) * (counts_bit[0] + counts_bit[2]) / row_sum;
-            ec[3] = (counts_bit[2] + counts_bit[3]) * (counts_bit[1] + counts_bit[3]) / row_sum;
-            ifault[i] = 0;
-        } else {
-            ifault[i] = loglin_api(counts_bit, ec, n);
-        }
-        
-        // calculate gensim score
-        // https://radimrehurek.com/gensim/models/phrases.html#gensim.models.phrases.Phrases
-        // gensim = (cnt(a, b) - min_count) * N / (cnt(a) * cnt(b))
-        //gensim[i] = (counts_bit[std::pow(2, n) - 1] - count_min) * nseqs/mc_product;
-        
-        //LFMD
-        //see http://www.lrec-conf.org/proceedings/lrec2002/pdf/128.pdf for details about LFMD
-        //LFMD = log2(P(w1,w2)^2/P(w1)P(w2)) + log2(P(w1,w2))
-        lfmd[i] = log2( pow(counts_bit[csize - 1], 2)/ ec[csize -1] ) + log2(counts_bit[csize - 1]);
-        
-        //pmi
-        pmi[i] = log2(counts_bit[csize - 1]/ ec[csize -1]);
-        
-        
-        //logratio
-        logratio[i] = 0.0;
-        double epsilon = 0.000000001; // to offset zero cell counts
-        for (std::size_t k = 0; k < csize; k++){
-            logratio[i] += counts_bit[k] * log(counts_bit[k]/ec[k] + epsilon);
-        }
-        logratio[i] *= 2;
-        
-        //chi2
-        chi2[i] = 0.0;
-        for (std::size_t k = 0; k < csize; k++){
-            chi2[i] += std::pow((counts_bit[k] - ec[k]), 2)/ec[k];
-        }
-        
-        //output counts
-        //Convert sequences from integer to character
-        std::ostringstream out;
-        out<<std::setprecision(1)<<std::fixed<<std::showpoint<< counts_bit[0];
-        std::string this_count = out.str();
-        for (std::size_t j = 1; j < csize; j++) {
-            std::ostringstream out;
-            out<<std::setprecision(1)<<std::fixed<<std::showpoint<< counts_bit[j];
-            this_count = this_count + '_' + out.str();
-        }
-        ob_n[i] = this_count;
-        
-        std::ostringstream out_ec;
-        out_ec<<std::setprecision(1)<<std::fixed<<std::showpoint<< ec[0];
-        std::string this_count_ec = out_ec.str();
-        for (std::size_t j = 1; j < csize; j++) {
-            std::ostringstream out_ec;
-            out_ec<<std::setprecision(1)<<std::fixed<<std::showpoint<< ec[j];
-            this_count_ec = this_count_ec + '_' + out_ec.str();
-        }
-        exp_n[i] = this_count_ec;
-        ///end of out
-    }
+    //output counts
+    ob_n[i] = join_counts<N>(counts_bit);
+    exp_n[i] = join_counts<N>(ec);
+    ///end of out
 }
 
+template <std::size_t N>
 struct estimates_mt : public Worker{
     VecNgrams &seqs_np;
-    IntParams &cs_np;
+    CountParams &cs_np;
     VecNgrams &seqs;
-    IntParams &cs;
+    CountParams &cs;
+    const std::vector<std::size_t> &starts;
+    const Marginals &marginals;
     DoubleParams &sgma;
     DoubleParams &lmda;
     DoubleParams &dice;
@@ -291,21 +336,396 @@ struct estimates_mt : public Worker{
     StringParams &exp_n;
     
     // Constructor
-    estimates_mt(VecNgrams &seqs_np_, IntParams &cs_np_, VecNgrams &seqs_, IntParams &cs_, DoubleParams &ss_, DoubleParams &ls_, DoubleParams &dice_,
+    estimates_mt(VecNgrams &seqs_np_, CountParams &cs_np_, VecNgrams &seqs_, CountParams &cs_, const std::vector<std::size_t> &starts_, const Marginals &marginals_, DoubleParams &ss_, DoubleParams &ls_, DoubleParams &dice_,
                  DoubleParams &pmi_, DoubleParams &logratio_, DoubleParams &chi2_, DoubleParams &gensim_, DoubleParams &lfmd_, IntParams &ifault, const std::string &method,
                  const unsigned int &count_min_, const double nseqs_, const double smoothing_, StringParams &ob_n_, StringParams &exp_n_):
-        seqs_np(seqs_np_), cs_np(cs_np_), seqs(seqs_), cs(cs_), sgma(ss_), lmda(ls_), dice(dice_), pmi(pmi_), logratio(logratio_), chi2(chi2_),
+        seqs_np(seqs_np_), cs_np(cs_np_), seqs(seqs_), cs(cs_), starts(starts_), marginals(marginals_), sgma(ss_), lmda(ls_), dice(dice_), pmi(pmi_), logratio(logratio_), chi2(chi2_),
         gensim(gensim_), lfmd(lfmd_), ifault(ifault), method(method), count_min(count_min_), nseqs(nseqs_), smoothing(smoothing_), ob_n(ob_n_), exp_n(exp_n_){}
     
     void operator()(std::size_t begin, std::size_t end){
         for (std::size_t i = begin; i < end; i++) {
-            estimates(i, seqs_np, cs_np, seqs, cs, sgma, lmda, dice, pmi, logratio, chi2, gensim, lfmd, ifault, method, count_min, nseqs, smoothing, ob_n, exp_n);
+            estimates<N>(i, seqs_np, cs_np, seqs, cs, starts, marginals, sgma, lmda, dice, pmi, logratio, chi2, gensim, lfmd, ifault, method, count_min, nseqs, smoothing, ob_n, exp_n);
         }
     }
 };
 
+// estimate all the candidates of the same size
+template <std::size_t N>
+void estimates_size(VecNgrams &seqs_np, CountParams &cs_np, VecNgrams &seqs, CountParams &cs, const std::vector<std::size_t> &starts, DoubleParams &sgma, DoubleParams &lmda, DoubleParams &dice,
+                    DoubleParams &pmi, DoubleParams &logratio, DoubleParams &chi2, DoubleParams &gensim, DoubleParams &lfmd, IntParams &ifault, const std::string &method,
+                    const unsigned int &count_min, const double nseqs, const double smoothing, StringParams &ob_n, StringParams &exp_n,
+                    Progress &progress){
+    // bigrams are estimated from the marginals in linear time
+    Marginals marginals;
+    if (N == 2) count_marginals(seqs, cs, starts, marginals);
+    estimates_mt<N> estimate_mt(seqs_np, cs_np, seqs, cs, starts, marginals, sgma, lmda, dice, pmi, logratio, chi2, gensim, lfmd, ifault, method, count_min, nseqs, smoothing, ob_n, exp_n);
+    run_chunks(estimate_mt, 0, seqs_np.size(), progress, "Estimating size " + std::to_string(N));
+}
+
+typedef void (*EstimatesSize)(VecNgrams &, CountParams &, VecNgrams &, CountParams &, const std::vector<std::size_t> &, DoubleParams &, DoubleParams &, DoubleParams &,
+                              DoubleParams &, DoubleParams &, DoubleParams &, DoubleParams &, DoubleParams &, IntParams &, const std::string &,
+                              const unsigned int &, const double, const double, StringParams &, StringParams &,
+                              Progress &);
+
+// instances of estimates_size() indexed by the size of collocations
+const EstimatesSize estimates_sizes[COLLOCATIONS_MAX_SIZE + 1] = {
+    NULL, NULL, estimates_size<2>, estimates_size<3>, estimates_size<4>,
+    estimates_size<5>, estimates_size<6>, estimates_size<7>, estimates_size<8>
+};
+
 Function warningR("warning");
 
+// scored collocations of all sizes
+struct Collocations {
+    VecNgrams seqs;
+    std::vector<int> gs;   // group of sequence
+    std::vector<std::string> gaps; // tokens skipped in sequence
+    std::vector<Count> cs; // count of sequence
+    std::vector<int> ns;   //length of sequence
+    std::vector<double> sgma;
+    std::vector<double> lmda;
+    std::vector<double> dice;
+    std::vector<double> pmi;
+    std::vector<double> logratio;
+    std::vector<double> chi2;
+    std::vector<double> gensim;
+    std::vector<double> lfmd;
+    std::vector<std::string> ob; //output oberved and expected counting
+    std::vector<std::string> exp;
+};
+
+// count types in unique texts with their weights
+struct counts_unigram_mt : public Worker{
+    
+    Texts &texts;
+    const std::vector<std::size_t> &uniques;
+    const std::vector<unsigned int> &weights;
+    std::vector<CountParam> &counts_type;
+    
+    counts_unigram_mt(Texts &texts_, const std::vector<std::size_t> &uniques_, const std::vector<unsigned int> &weights_,
+                      std::vector<CountParam> &counts_type_):
+        texts(texts_), uniques(uniques_), weights(weights_), counts_type(counts_type_){}
+    
+    void operator()(std::size_t begin, std::size_t end){
+        for (std::size_t u = begin; u < end; u++){
+            const Text &text = texts[uniques[u]];
+            for (std::size_t i = 0; i < text.size(); i++) {
+                counts_type[text[i]] += weights[u];
+            }
+        }
+    }
+};
+
+// mask types that occur less than count_min times; n-grams that contain them are 
+// less frequent than count_min, so they are counted with other windows with masked 
+// tokens. This does not change the tables of the other candidates because the rare 
+// types never match their tokens.
+std::vector<bool> mask_rare(Texts &texts,
+                            const std::vector<std::size_t> &uniques,
+                            const std::vector<unsigned int> &weights,
+                            const unsigned int count_min,
+                            const std::vector<bool> &mask){
+    
+    std::vector<bool> mask_new(mask);
+    if (count_min <= 1) return mask_new;
+    std::vector<CountParam> counts_type(mask.size());
+#if QUANTEDA_USE_TBB
+    counts_unigram_mt count_mt(texts, uniques, weights, counts_type);
+    parallelFor(0, uniques.size(), count_mt);
+#else
+    for (std::size_t u = 0; u < uniques.size(); u++) {
+        const Text &text = texts[uniques[u]];
+        for (std::size_t i = 0; i < text.size(); i++) {
+            counts_type[text[i]] += weights[u];
+        }
+    }
+#endif
+    for (std::size_t g = 1; g < mask_new.size(); g++) {
+        if (counts_type[g] < count_min) mask_new[g] = true;
+    }
+    return mask_new;
+}
+
+// unique texts counted for all the sizes
+struct UniqueTexts {
+    std::vector<std::size_t> uniques;  // positions of unique texts
+    std::vector<unsigned int> weights; // numbers of identical texts
+    std::vector<bool> mask;            // types that cannot be part of collocations
+    CompactTexts compact;              // unique texts if compressed
+    bool is_compact = false;
+};
+
+// collapse identical texts and mask rare types; if compact is true, the unique texts 
+// are compressed so that texts can be released by the caller
+void unique_texts(Texts &texts,
+                  const std::vector<unsigned int> &groups,
+                  const std::vector<bool> &mask,
+                  const unsigned int count_min,
+                  const bool compact,
+                  UniqueTexts &unique){
+    
+    collapse_texts(texts, groups, unique.uniques, unique.weights);
+    unique.mask = mask_rare(texts, unique.uniques, unique.weights, count_min, mask);
+    if (compact) {
+        unique.compact = CompactTexts(texts, unique.uniques, mask.size());
+        unique.is_compact = true;
+    }
+}
+
+// sequences of a size arranged by groups
+struct Sequences {
+    VecNgrams seqs;     // all sequences including those with masked tokens
+    CountParams cs;     // count of sequences
+    VecNgrams seqs_np;  // sequences without masked tokens
+    CountParams cs_np;
+    std::vector<std::size_t> starts;    // positions of groups in seqs
+    std::vector<std::size_t> starts_np; // positions of groups in seqs_np
+    Ngrams patterns;    // offsets of tokens in windows
+    double total_counts = 0.0;
+};
+
+// count sequences of a size in each group in a single pass; the sequences are 
+// arranged by groups and patterns of windows, which are identified by 
+// group * patterns.size() + pattern
+void sequences_size(Texts &texts,
+                    const std::vector<unsigned int> &groups,
+                    const std::size_t len_groups,
+                    const UniqueTexts &unique,
+                    const unsigned int mw_len,
+                    const unsigned int window,
+                    Sequences &sequences,
+                    Progress &progress){
+    
+    // Count identical texts only once
+    const std::vector<std::size_t> &uniques = unique.uniques;
+    const std::vector<unsigned int> &weights = unique.weights;
+    const std::vector<bool> &mask = unique.mask;
+    
+    // Collect all sequences of specified words
+    Ngrams &patterns = sequences.patterns;
+    patterns = make_patterns(mw_len, window);
+    MapCounts counts_seq(mw_len + 1);  // candidates
+    MapCounts counts_part(mw_len + 1); // windows with masked tokens
+    std::size_t len_windows = 0;
+    for (std::size_t u = 0; u < uniques.size(); u++) {
+        std::size_t len_text = unique.is_compact ? unique.compact.lengths[u] : texts[uniques[u]].size();
+        len_windows += len_text * patterns.size();
+    }
+    counts_seq.reserve(std::min(len_windows, COLLOCATIONS_RESERVE_MAX));
+    //dev::Timer timer;
+    //dev::start_timer("Count", timer);
+    std::string phase = "Counting size " + std::to_string(mw_len);
+    if (unique.is_compact) {
+        counts_compact_mt count_mt(unique.compact, groups, uniques, weights, counts_seq, counts_part, mw_len, patterns, mask);
+        if (!run_chunks(count_mt, 0, uniques.size(), progress, phase)) return;
+    } else {
+        counts_mt count_mt(texts, groups, uniques, weights, counts_seq, counts_part, mw_len, patterns, mask);
+        if (!run_chunks(count_mt, 0, uniques.size(), progress, phase)) return;
+    }
+    //dev::stop_timer("Count", timer);
+    
+    // Separate map keys and values, arranging them by groups
+    std::size_t len_noPadding = counts_seq.size();
+    std::size_t len = len_noPadding + counts_part.size();
+    std::vector<std::size_t> &starts = sequences.starts;
+    std::vector<std::size_t> &starts_np = sequences.starts_np;
+    std::size_t len_keys = len_groups * patterns.size();
+    starts.assign(len_keys + 1, 0);
+    starts_np.assign(len_keys + 1, 0);
+    counts_seq.for_each([&](const Ngram &ngram, const Count count) {
+        starts[ngram[mw_len] + 1]++;
+        starts_np[ngram[mw_len] + 1]++;
+    });
+    counts_part.for_each([&](const Ngram &ngram, const Count count) {
+        starts[ngram[mw_len] + 1]++;
+    });
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+    std::partial_sum(starts_np.begin(), starts_np.end(), starts_np.begin());
+    
+    VecNgrams &seqs = sequences.seqs, &seqs_np = sequences.seqs_np;
+    CountParams &cs = sequences.cs, &cs_np = sequences.cs_np;
+    seqs.resize(len);
+    seqs_np.resize(len_noPadding);
+    cs.resize(len);
+    cs_np.resize(len_noPadding);
+    std::vector<std::size_t> pos(starts.begin(), starts.end() - 1);
+    std::vector<std::size_t> pos_np(starts_np.begin(), starts_np.end() - 1);
+    double &total_counts = sequences.total_counts;
+    counts_seq.for_each([&](const Ngram &ngram, const Count count) {
+        std::size_t g = ngram[mw_len];
+        seqs[pos[g]] = ngram;
+        cs[pos[g]++] = count;
+        total_counts += count;
+        seqs_np[pos_np[g]] = ngram;
+        cs_np[pos_np[g]++] = count;
+    });
+    // windows with masked tokens only contribute to the marginal counts
+    counts_part.for_each([&](const Ngram &ngram, const Count count) {
+        std::size_t g = ngram[mw_len];
+        seqs[pos[g]] = ngram;
+        cs[pos[g]++] = count;
+        total_counts += count;
+    });
+}
+
+// count and estimate collocations of a size in each group and append them to colls;
+// nothing is appended if the user interrupted
+void collocations_size(Texts &texts,
+                       const std::vector<unsigned int> &groups,
+                       const std::size_t len_groups,
+                       const UniqueTexts &unique,
+                       const unsigned int mw_len,
+                       const unsigned int window,
+                       const unsigned int count_min,
+                       const std::string &method,
+                       const double smoothing,
+                       Collocations &colls,
+                       std::vector<int> &iwarning,
+                       Progress &progress){
+    
+    Sequences sequences;
+    sequences_size(texts, groups, len_groups, unique, mw_len, window, sequences, progress);
+    if (progress.cancelled) return;
+    VecNgrams &seqs = sequences.seqs, &seqs_np = sequences.seqs_np;
+    CountParams &cs = sequences.cs, &cs_np = sequences.cs_np;
+    std::size_t len_noPadding = seqs_np.size();
+    double total_counts = sequences.total_counts;
+    
+    //output counts;
+    StringParams ob_n(len_noPadding);
+    StringParams exp_n(len_noPadding);
+    
+    // adjust total_counts of MW 
+    total_counts += 4 * smoothing;
+    
+    // Estimate significance of the sequences
+    DoubleParams sgma(len_noPadding);
+    DoubleParams lmda(len_noPadding);
+    DoubleParams dice(len_noPadding);
+    DoubleParams pmi(len_noPadding);
+    DoubleParams logratio(len_noPadding);
+    DoubleParams chi2(len_noPadding);
+    DoubleParams gensim(len_noPadding);
+    DoubleParams lfmd(len_noPadding);
+    IntParams ifault(len_noPadding, 0);
+    //dev::start_timer("Estimate", timer);
+    estimates_sizes[mw_len](seqs_np, cs_np, seqs, cs, sequences.starts, sgma, lmda, dice, pmi, logratio, chi2, gensim, lfmd, ifault, method, count_min, total_counts, smoothing, ob_n, exp_n, progress);
+    if (progress.cancelled) return;
+    //output warning message
+    warn_ifault(ifault, iwarning, warningR);
+    
+    //dev::stop_timer("Estimate", timer);
+    std::size_t len_patterns = sequences.patterns.size();
+    for (std::size_t i = 0; i < len_noPadding; i++) {
+        colls.seqs.push_back(Ngram(seqs_np[i].begin(), seqs_np[i].begin() + mw_len));
+        colls.gs.push_back(seqs_np[i][mw_len] / len_patterns);
+        colls.gaps.push_back(join_gaps(sequences.patterns[seqs_np[i][mw_len] % len_patterns]));
+        colls.cs.push_back(cs_np[i]);
+        colls.ns.push_back(mw_len);
+    }
+    colls.sgma.insert( colls.sgma.end(), sgma.begin(), sgma.end() );
+    colls.lmda.insert( colls.lmda.end(), lmda.begin(), lmda.end() );
+    colls.dice.insert( colls.dice.end(), dice.begin(), dice.end() );
+    colls.pmi.insert( colls.pmi.end(), pmi.begin(), pmi.end() );
+    colls.logratio.insert( colls.logratio.end(), logratio.begin(), logratio.end() );
+    colls.chi2.insert( colls.chi2.end(), chi2.begin(), chi2.end() );
+    colls.gensim.insert( colls.gensim.end(), gensim.begin(), gensim.end() );
+    colls.lfmd.insert( colls.lfmd.end(), lfmd.begin(), lfmd.end() );
+    
+    //output counts
+    colls.ob.insert( colls.ob.end(), ob_n.begin(), ob_n.end() );
+    colls.exp.insert( colls.exp.end(), exp_n.begin(), exp_n.end() );
+}
+
+// select the measure used to rank or choose collocations
+double select_measure(const Collocations &colls, const std::size_t i, const std::string &method){
+    if (method == "lr") return colls.logratio[i];
+    if (method == "chi2") return colls.chi2[i];
+    if (method == "pmi") return colls.pmi[i];
+    if (method == "LFMD") return colls.lfmd[i];
+    return colls.lmda[i] / colls.sgma[i]; // z for lambda methods
+}
+
+template <typename V>
+void permute(V &values, const std::vector<std::size_t> &index){
+    V temp(values.size());
+    for (std::size_t k = 0; k < index.size(); k++) {
+        temp[k] = values[index[k]];
+    }
+    values.swap(temp);
+}
+
+// rank collocations by group and decreasing measure; ties are broken by the length, 
+// the type ids and the gaps of the sequences so that the order is deterministic
+void rank_collocations(Collocations &colls, const std::string &method){
+    
+    std::size_t len = colls.seqs.size();
+    std::vector<double> scores(len);
+    for (std::size_t i = 0; i < len; i++) {
+        double score = select_measure(colls, i, method);
+        scores[i] = std::isnan(score) ? -std::numeric_limits<double>::infinity() : score;
+    }
+    std::vector<std::size_t> index(len);
+    std::iota(index.begin(), index.end(), 0);
+    auto compare = [&colls, &scores](std::size_t i1, std::size_t i2) {
+        if (colls.gs[i1] != colls.gs[i2]) return colls.gs[i1] < colls.gs[i2];
+        if (scores[i1] != scores[i2]) return scores[i1] > scores[i2];
+        if (colls.ns[i1] != colls.ns[i2]) return colls.ns[i1] < colls.ns[i2];
+        if (colls.seqs[i1] != colls.seqs[i2]) return colls.seqs[i1] < colls.seqs[i2];
+        return colls.gaps[i1] < colls.gaps[i2];
+    };
+#if QUANTEDA_USE_TBB
+    tbb::parallel_sort(index.begin(), index.end(), compare);
+#else
+    std::sort(index.begin(), index.end(), compare);
+#endif
+    
+    permute(colls.seqs, index);
+    permute(colls.gs, index);
+    permute(colls.gaps, index);
+    permute(colls.cs, index);
+    permute(colls.ns, index);
+    permute(colls.sgma, index);
+    permute(colls.lmda, index);
+    permute(colls.dice, index);
+    permute(colls.pmi, index);
+    permute(colls.logratio, index);
+    permute(colls.chi2, index);
+    permute(colls.gensim, index);
+    permute(colls.lfmd, index);
+    permute(colls.ob, index);
+    permute(colls.exp, index);
+}
+
+// convert collocations to a data.frame
+DataFrame as_dataframe(Collocations &colls,
+                       const CharacterVector &types_){
+    
+    // Convert sequences from integer to character
+    CharacterVector seqs_(colls.seqs.size());
+    for (std::size_t i = 0; i < colls.seqs.size(); i++) {
+        seqs_[i] = join_strings(colls.seqs[i], types_, " ");
+    }
+    
+    DataFrame output_ = DataFrame::create(_["collocation"] = seqs_,
+                                          _["group"] = as<IntegerVector>(wrap(colls.gs)),
+                                          _["gaps"] = colls.gaps,
+                                          _["count"] = as_counts(colls.cs),
+                                          _["length"] = as<NumericVector>(wrap(colls.ns)),
+                                          _["method"] = as<NumericVector>(wrap(colls.lmda)),
+                                          _["sigma"] = as<NumericVector>(wrap(colls.sgma)),
+                                          _["dice"] = as<NumericVector>(wrap(colls.dice)),
+                                          _["gensim"] = as<NumericVector>(wrap(colls.gensim)),
+                                          _["pmi"] = as<NumericVector>(wrap(colls.pmi)),
+                                          _["G2"] = as<NumericVector>(wrap(colls.logratio)),
+                                          _["chi2"] = as<NumericVector>(wrap(colls.chi2)),
+                                          _["LFMD"] = as<NumericVector>(wrap(colls.lfmd)),
+                                          _["observed_counts"] = colls.ob,
+                                          _["expected_counts"] = colls.exp,
+                                          _["stringsAsFactors"] = false);
+    return output_;
+}
+
 /* 
  * This funciton estimate the strength of association between specified words 
  * that appear in sequences. 
@@ -314,6 +734,20 @@ Function warningR("warning");
  * @param count_min sequences appear less than this are ignored
  * @param method 
  * @param smoothing
+ * @param ignores_ ids of types that cannot be part of collocations (e.g. punctuation)
+ * @param groups_ 0-based group of documents; collocations are scored in each group
+ * separately. All the documents are in the same group if empty.
+ * @param window if larger than the size, collocations are also counted for tokens that
+ * are not adjacent but within windows of this number of tokens, separately for each
+ * pattern of gaps
+ * @param verbose report progress of counting and estimation
+ * @param rank if true, rows are sorted by groups and decreasing scores of the method
+ * (z for lambda methods); otherwise, the order of rows is undefined.
+ * @param compact_min texts are compressed in counting if they have at least this 
+ * number of tokens in total; COLLOCATIONS_COMPACT_MIN is used if negative
+ * 
+ * If the user interrupts, collocations of the completed sizes are returned with an
+ * "interrupted" attribute.
  */
 
 // [[Rcpp::export]]
@@ -322,197 +756,1196 @@ DataFrame qatd_cpp_collocations_dev(const List &texts_,
                                     const unsigned int count_min,
                                     const IntegerVector sizes_,
                                     const std::string method,
-                                    const double smoothing){
+                                    const double smoothing,
+                                    const IntegerVector ignores_,
+                                    const IntegerVector groups_,
+                                    const unsigned int window,
+                                    const bool verbose,
+                                    const bool rank,
+                                    const double compact_min){
     
     Texts texts = as<Texts>(texts_);
     std::vector<unsigned int> sizes = as< std::vector<unsigned int> >(sizes_);
-    unsigned int len_coe = sizes.size() * types_.size();
+    check_sizes(sizes);
+    std::vector<bool> mask = make_mask(ignores_, types_.size());
+    
+    std::vector<unsigned int> groups(texts.size(), 0);
+    std::size_t len_groups = 1;
+    if (groups_.size() > 0) {
+        if ((std::size_t)groups_.size() != texts.size())
+            throw std::range_error("Invalid length of groups");
+        for (std::size_t h = 0; h < texts.size(); h++) {
+            if (groups_[h] < 0)
+                throw std::range_error("Invalid groups");
+            groups[h] = groups_[h];
+            if (groups[h] + 1 > len_groups) len_groups = groups[h] + 1;
+        }
+    }
+    
+    // compress large corpora and release the original texts
+    std::size_t len_tokens = 0;
+    for (std::size_t h = 0; h < texts.size(); h++) len_tokens += texts[h].size();
+    double len_min = compact_min < 0 ? COLLOCATIONS_COMPACT_MIN : compact_min;
+    UniqueTexts unique;
+    unique_texts(texts, groups, mask, count_min, len_tokens >= len_min, unique);
+    if (unique.is_compact) Texts().swap(texts);
+    
+    Collocations colls;
+    //warning sign
+    std::vector<int> iwarning(3, 0);
+    Progress progress(verbose);
+    for (std::size_t m = 0; m < sizes.size(); m++) {
+        collocations_size(texts, groups, len_groups, unique, sizes[m], window, count_min, method, smoothing, colls, iwarning, progress);
+        if (progress.cancelled) break;
+    }
+    if (rank) rank_collocations(colls, method);
+    DataFrame output_ = as_dataframe(colls, types_);
+    if (progress.cancelled) output_.attr("interrupted") = true;
+    return output_;
+}
 
-    // Estimate significance of the sequences
-    std::vector<double> sgma_all;
-    sgma_all.reserve(len_coe);
+/* 
+ * This funciton nominates candidates for qatd_cpp_collocations_targeted() by counting 
+ * sequences without scoring them.
+ * @used textstat_collocationsdev()
+ * @param texts_ tokens object
+ * @param count_min sequences appear less than this are not nominated
+ * @param ignores_ ids of types that cannot be part of collocations (e.g. punctuation)
+ * @param verbose report progress of counting
+ * @param compact_min texts are compressed in counting if they have at least this 
+ * number of tokens in total; COLLOCATIONS_COMPACT_MIN is used if negative
+ * 
+ * Returns a list of type ids of candidates. If the user interrupts, candidates of the 
+ * completed sizes are returned with an "interrupted" attribute.
+ */
+
+// [[Rcpp::export]]
+List qatd_cpp_collocations_nominate(const List &texts_,
+                                    const CharacterVector &types_,
+                                    const unsigned int count_min,
+                                    const IntegerVector sizes_,
+                                    const IntegerVector ignores_,
+                                    const bool verbose,
+                                    const double compact_min){
     
-    std::vector<double> lmda_all;
-    lmda_all.reserve(len_coe);
+    Texts texts = as<Texts>(texts_);
+    std::vector<unsigned int> sizes = as< std::vector<unsigned int> >(sizes_);
+    check_sizes(sizes);
+    std::vector<bool> mask = make_mask(ignores_, types_.size());
+    std::vector<unsigned int> groups(texts.size(), 0);
     
-    std::vector<double> dice_all;
-    dice_all.reserve(len_coe);
+    std::size_t len_tokens = 0;
+    for (std::size_t h = 0; h < texts.size(); h++) len_tokens += texts[h].size();
+    double len_min = compact_min < 0 ? COLLOCATIONS_COMPACT_MIN : compact_min;
+    UniqueTexts unique;
+    unique_texts(texts, groups, mask, count_min, len_tokens >= len_min, unique);
+    if (unique.is_compact) Texts().swap(texts);
     
-    std::vector<double> pmi_all;
-    pmi_all.reserve(len_coe);
+    VecNgrams cands;
+    Progress progress(verbose);
+    for (std::size_t m = 0; m < sizes.size(); m++) {
+        Sequences sequences;
+        sequences_size(texts, groups, 1, unique, sizes[m], 0, sequences, progress);
+        if (progress.cancelled) break;
+        // sequences without masked tokens are unique in a single group
+        for (std::size_t i = 0; i < sequences.seqs_np.size(); i++) {
+            if (sequences.cs_np[i] < count_min) continue;
+            cands.push_back(Ngram(sequences.seqs_np[i].begin(), sequences.seqs_np[i].begin() + sizes[m]));
+        }
+    }
     
-    std::vector<double> logratio_all;
-    logratio_all.reserve(len_coe);
+    List output_(cands.size());
+    for (std::size_t i = 0; i < cands.size(); i++) {
+        output_[i] = IntegerVector(cands[i].begin(), cands[i].end());
+    }
+    if (progress.cancelled) output_.attr("interrupted") = true;
+    return output_;
+}
+
+
+// estimate a candidate in the target (group 1) and reference (group 0) documents
+template <std::size_t N>
+void estimates_compare(std::size_t i,
+                       const VecNgrams &cands,
+                       const Sequences &sequences,
+                       std::vector<Measures> &measures,
+                       std::vector<Measures> &measures_ref,
+                       CountParams &cs,
+                       CountParams &cs_ref,
+                       const std::string &method,
+                       const double smoothing){
     
-    std::vector<double> chi2_all;
-    chi2_all.reserve(len_coe);
+    const std::vector<std::size_t> &starts = sequences.starts;
+    Table<N> counts_bit, ec;
     
-    std::vector<double> gensim_all;
-    gensim_all.reserve(len_coe);
+    counts_bit.fill(smoothing);
+    count_table<N>(cands[i], sequences.seqs, sequences.cs, starts[1], starts[2], counts_bit);
+    cs[i] = (Count)(counts_bit[(1 << N) - 1] - smoothing);
+    measures[i] = score<N>(counts_bit, ec, method);
     
-    std::vector<double> lfmd_all;
-    lfmd_all.reserve(len_coe);
+    counts_bit.fill(smoothing);
+    count_table<N>(cands[i], sequences.seqs, sequences.cs, starts[0], starts[1], counts_bit);
+    cs_ref[i] = (Count)(counts_bit[(1 << N) - 1] - smoothing);
+    measures_ref[i] = score<N>(counts_bit, ec, method);
+}
+
+template <std::size_t N>
+struct estimates_compare_mt : public Worker{
     
-    std::vector<int> cs_all;   // count of sequence
-    cs_all.reserve(len_coe);
+    const VecNgrams &cands;
+    const Sequences &sequences;
+    std::vector<Measures> &measures;
+    std::vector<Measures> &measures_ref;
+    CountParams &cs;
+    CountParams &cs_ref;
+    const std::string &method;
+    const double smoothing;
     
-    std::vector<int> ns_all; //length of sequence
-    ns_all.reserve(len_coe);
+    estimates_compare_mt(const VecNgrams &cands_, const Sequences &sequences_, std::vector<Measures> &measures_,
+                         std::vector<Measures> &measures_ref_, CountParams &cs_, CountParams &cs_ref_,
+                         const std::string &method_, const double smoothing_):
+        cands(cands_), sequences(sequences_), measures(measures_), measures_ref(measures_ref_), cs(cs_), 
+        cs_ref(cs_ref_), method(method_), smoothing(smoothing_){}
     
-    VecNgrams seqs_all;
-    seqs_all.reserve(len_coe);
+    void operator()(std::size_t begin, std::size_t end){
+        for (std::size_t i = begin; i < end; i++) {
+            estimates_compare<N>(i, cands, sequences, measures, measures_ref, cs, cs_ref, method, smoothing);
+        }
+    }
+};
+
+// estimate all the candidates of the same size in both target and reference documents
+template <std::size_t N>
+void compare_size(const VecNgrams &cands, const Sequences &sequences, std::vector<Measures> &measures,
+                  std::vector<Measures> &measures_ref, CountParams &cs, CountParams &cs_ref,
+                  const std::string &method, const double smoothing){
+#if QUANTEDA_USE_TBB
+    estimates_compare_mt<N> estimate_mt(cands, sequences, measures, measures_ref, cs, cs_ref, method, smoothing);
+    parallelFor(0, cands.size(), estimate_mt);
+#else
+    for (std::size_t i = 0; i < cands.size(); i++) {
+        estimates_compare<N>(i, cands, sequences, measures, measures_ref, cs, cs_ref, method, smoothing);
+    }
+#endif
+}
+
+typedef void (*CompareSize)(const VecNgrams &, const Sequences &, std::vector<Measures> &,
+                            std::vector<Measures> &, CountParams &, CountParams &,
+                            const std::string &, const double);
+
+// instances of compare_size() indexed by the size of collocations
+const CompareSize compare_sizes[COLLOCATIONS_MAX_SIZE + 1] = {
+    NULL, NULL, compare_size<2>, compare_size<3>, compare_size<4>,
+    compare_size<5>, compare_size<6>, compare_size<7>, compare_size<8>
+};
+
+/* 
+ * This funciton estimate the strength of association of collocations in target and
+ * reference documents. Both sets of documents are counted in a single pass with the
+ * group in the keys, and candidates that appear in both are estimated only once.
+ * @used textstat_keycollocationsdev()
+ * @param texts_ tokens object
+ * @param count_min collocations that appear less than this in both target and reference are ignored
+ * @param method 
+ * @param smoothing
+ * @param ignores_ ids of types that cannot be part of collocations (e.g. punctuation)
+ * @param targets_ TRUE for target documents and FALSE for reference documents
+ */
+
+// [[Rcpp::export]]
+DataFrame qatd_cpp_collocations_compare(const List &texts_,
+                                        const CharacterVector &types_,
+                                        const unsigned int count_min,
+                                        const IntegerVector sizes_,
+                                        const std::string method,
+                                        const double smoothing,
+                                        const IntegerVector ignores_,
+                                        const LogicalVector targets_){
     
-    //output oberved and expected counting
-    std::vector<std::string> ob_all;
-    ob_all.reserve(len_coe);
+    Texts texts = as<Texts>(texts_);
+    std::vector<unsigned int> sizes = as< std::vector<unsigned int> >(sizes_);
+    check_sizes(sizes);
+    std::vector<bool> mask = make_mask(ignores_, types_.size());
     
-    std::vector<std::string> exp_all;
-    exp_all.reserve(len_coe);
+    if ((std::size_t)targets_.size() != texts.size())
+        throw std::range_error("Invalid length of targets");
+    std::vector<unsigned int> groups(texts.size());
+    for (std::size_t h = 0; h < texts.size(); h++) {
+        groups[h] = targets_[h] == TRUE ? 1 : 0;
+    }
     
-    //warning sign
+    Ngrams seqs;
+    std::vector<Count> cs, cs_ref;
+    std::vector<int> ns;
+    std::vector<Measures> measures, measures_ref;
+    UniqueTexts unique;
+    unique_texts(texts, groups, mask, count_min, false, unique);
+    Progress progress;
+    for (std::size_t m = 0; m < sizes.size(); m++) {
+        Sequences sequences;
+        sequences_size(texts, groups, 2, unique, sizes[m], 0, sequences, progress);
+        if (progress.cancelled) throw internal::InterruptedException();
+        
+        // candidates frequent in either target or reference are stored once
+        SetNgrams set_cands;
+        VecNgrams cands;
+        for (std::size_t i = 0; i < sequences.seqs_np.size(); i++) {
+            if (sequences.cs_np[i] < count_min) continue;
+            Ngram cand(sequences.seqs_np[i].begin(), sequences.seqs_np[i].begin() + sizes[m]);
+            if (set_cands.insert(cand).second) cands.push_back(cand);
+        }
+        
+        std::vector<Measures> measures_size(cands.size()), measures_ref_size(cands.size());
+        CountParams cs_size(cands.size()), cs_ref_size(cands.size());
+        compare_sizes[sizes[m]](cands, sequences, measures_size, measures_ref_size, 
+                                cs_size, cs_ref_size, method, smoothing);
+        
+        seqs.insert(seqs.end(), cands.begin(), cands.end());
+        cs.insert(cs.end(), cs_size.begin(), cs_size.end());
+        cs_ref.insert(cs_ref.end(), cs_ref_size.begin(), cs_ref_size.end());
+        ns.insert(ns.end(), cands.size(), sizes[m]);
+        measures.insert(measures.end(), measures_size.begin(), measures_size.end());
+        measures_ref.insert(measures_ref.end(), measures_ref_size.begin(), measures_ref_size.end());
+    }
+    
+    std::size_t len = seqs.size();
+    CharacterVector seqs_(len);
+    NumericVector lmda_(len), sgma_(len), logratio_(len), lmda_ref_(len), sgma_ref_(len), logratio_ref_(len);
+    IntParams ifault(len * 2);
+    for (std::size_t i = 0; i < len; i++) {
+        seqs_[i] = join_strings(seqs[i], types_, " ");
+        lmda_[i] = measures[i].lmda;
+        sgma_[i] = measures[i].sgma;
+        logratio_[i] = measures[i].logratio;
+        lmda_ref_[i] = measures_ref[i].lmda;
+        sgma_ref_[i] = measures_ref[i].sgma;
+        logratio_ref_[i] = measures_ref[i].logratio;
+        ifault[i * 2] = measures[i].ifault;
+        ifault[i * 2 + 1] = measures_ref[i].ifault;
+    }
     std::vector<int> iwarning(3, 0);
+    warn_ifault(ifault, iwarning, warningR);
+    
+    DataFrame output_ = DataFrame::create(_["collocation"] = seqs_,
+                                          _["count"] = as_counts(cs),
+                                          _["count_ref"] = as_counts(cs_ref),
+                                          _["length"] = as<NumericVector>(wrap(ns)),
+                                          _["lambda"] = lmda_,
+                                          _["sigma"] = sgma_,
+                                          _["lambda_ref"] = lmda_ref_,
+                                          _["sigma_ref"] = sgma_ref_,
+                                          _["G2"] = logratio_,
+                                          _["G2_ref"] = logratio_ref_,
+                                          _["stringsAsFactors"] = false);
+    return output_;
+}
+
+// estimate a candidate with each of smoothing values from its raw table
+template <std::size_t N>
+void estimates_sweep(std::size_t i,
+                     const std::vector<std::size_t> &index,
+                     const Sequences &sequences,
+                     const std::vector<double> &smoothings,
+                     std::vector<Measures> &measures,
+                     const std::string &method){
+    
+    const VecNgrams &seqs_np = sequences.seqs_np;
+    std::size_t g = seqs_np[index[i]][N];
+    Table<N> counts_raw;
+    counts_raw.fill(0.0);
+    count_table<N>(seqs_np[index[i]], sequences.seqs, sequences.cs, 
+                   sequences.starts[g], sequences.starts[g + 1], counts_raw);
+    
+    Table<N> counts_bit, ec;
+    for (std::size_t k = 0; k < smoothings.size(); k++) {
+        for (std::size_t b = 0; b < (1 << N); b++) {
+            counts_bit[b] = counts_raw[b] + smoothings[k];
+        }
+        measures[i * smoothings.size() + k] = score<N>(counts_bit, ec, method);
+    }
+}
+
+template <std::size_t N>
+struct estimates_sweep_mt : public Worker{
     
-    for(unsigned int m = 0; m < sizes.size(); m++){
-        unsigned int mw_len = sizes[m];
-        // Collect all sequences of specified words
-        MapNgrams counts_seq;
-        //dev::Timer timer;
-        //dev::start_timer("Count", timer);
+    const std::vector<std::size_t> &index;
+    const Sequences &sequences;
+    const std::vector<double> &smoothings;
+    std::vector<Measures> &measures;
+    const std::string &method;
+    
+    estimates_sweep_mt(const std::vector<std::size_t> &index_, const Sequences &sequences_, 
+                       const std::vector<double> &smoothings_, std::vector<Measures> &measures_, 
+                       const std::string &method_):
+        index(index_), sequences(sequences_), smoothings(smoothings_), measures(measures_), method(method_){}
+    
+    void operator()(std::size_t begin, std::size_t end){
+        for (std::size_t i = begin; i < end; i++) {
+            estimates_sweep<N>(i, index, sequences, smoothings, measures, method);
+        }
+    }
+};
+
+// estimate all the candidates of the same size with each of smoothing values
+template <std::size_t N>
+void sweep_size(const std::vector<std::size_t> &index, const Sequences &sequences, 
+                const std::vector<double> &smoothings, std::vector<Measures> &measures, 
+                const std::string &method){
 #if QUANTEDA_USE_TBB
-        counts_mt count_mt(texts, counts_seq, mw_len);
-        parallelFor(0, texts.size(), count_mt);
+    estimates_sweep_mt<N> estimate_mt(index, sequences, smoothings, measures, method);
+    parallelFor(0, index.size(), estimate_mt);
 #else
-        for (std::size_t h = 0; h < texts.size(); h++) {
-            counts(texts[h], counts_seq, mw_len);
-        }
+    for (std::size_t i = 0; i < index.size(); i++) {
+        estimates_sweep<N>(i, index, sequences, smoothings, measures, method);
+    }
 #endif
-        //dev::stop_timer("Count", timer);
-        
-        // Separate map keys and values
-        std::size_t len = counts_seq.size();
-        VecNgrams seqs, seqs_np;   //seqs_np sequences without padding
-        IntParams cs, cs_np;    // cs: count of sequences;  
-        seqs.reserve(len);
-        seqs_np.reserve(len);
-        cs_np.reserve(len);
-        cs.reserve(len);
+}
+
+typedef void (*SweepSize)(const std::vector<std::size_t> &, const Sequences &, 
+                          const std::vector<double> &, std::vector<Measures> &, 
+                          const std::string &);
+
+// instances of sweep_size() indexed by the size of collocations
+const SweepSize sweep_sizes[COLLOCATIONS_MAX_SIZE + 1] = {
+    NULL, NULL, sweep_size<2>, sweep_size<3>, sweep_size<4>,
+    sweep_size<5>, sweep_size<6>, sweep_size<7>, sweep_size<8>
+};
+
+/* 
+ * This funciton estimate the strength of association with multiple smoothing values.
+ * The raw table of a candidate is constructed only once and smoothing values are 
+ * added to its copies. Thresholds of count_min are applied in R.
+ * @used textstat_sweepcollocationsdev()
+ * @param texts_ tokens object
+ * @param count_min sequences appear less than this are ignored
+ * @param method 
+ * @param smoothings_ smoothing values
+ * @param ignores_ ids of types that cannot be part of collocations (e.g. punctuation)
+ */
+
+// [[Rcpp::export]]
+DataFrame qatd_cpp_collocations_sweep(const List &texts_,
+                                      const CharacterVector &types_,
+                                      const unsigned int count_min,
+                                      const IntegerVector sizes_,
+                                      const std::string method,
+                                      const NumericVector smoothings_,
+                                      const IntegerVector ignores_){
+    
+    Texts texts = as<Texts>(texts_);
+    std::vector<unsigned int> sizes = as< std::vector<unsigned int> >(sizes_);
+    check_sizes(sizes);
+    std::vector<double> smoothings = as< std::vector<double> >(smoothings_);
+    std::vector<bool> mask = make_mask(ignores_, types_.size());
+    std::vector<unsigned int> groups(texts.size(), 0);
+    
+    std::size_t len_sm = smoothings.size();
+    Ngrams seqs;
+    std::vector<Count> cs;
+    std::vector<int> ns;
+    std::vector<Measures> measures;
+    UniqueTexts unique;
+    unique_texts(texts, groups, mask, count_min, false, unique);
+    Progress progress;
+    for (std::size_t m = 0; m < sizes.size(); m++) {
+        Sequences sequences;
+        sequences_size(texts, groups, 1, unique, sizes[m], 0, sequences, progress);
+        if (progress.cancelled) throw internal::InterruptedException();
         
+        std::vector<std::size_t> index;
+        for (std::size_t i = 0; i < sequences.seqs_np.size(); i++) {
+            if (sequences.cs_np[i] < count_min) continue;
+            index.push_back(i);
+            seqs.push_back(Ngram(sequences.seqs_np[i].begin(), sequences.seqs_np[i].begin() + sizes[m]));
+            cs.push_back(sequences.cs_np[i]);
+            ns.push_back(sizes[m]);
+        }
+        std::vector<Measures> measures_size(index.size() * len_sm);
+        sweep_sizes[sizes[m]](index, sequences, smoothings, measures_size, method);
+        measures.insert(measures.end(), measures_size.begin(), measures_size.end());
+    }
+    
+    // output in long form, candidates repeated for each smoothing value
+    std::size_t len = measures.size();
+    CharacterVector seqs_(len);
+    CountVector cs_(len);
+    NumericVector ns_(len), sm_(len), lmda_(len), sgma_(len), pmi_(len), logratio_(len), chi2_(len), lfmd_(len);
+    IntParams ifault(len);
+    for (std::size_t i = 0; i < seqs.size(); i++) {
+        String seq_ = join_strings(seqs[i], types_, " ");
+        for (std::size_t k = 0; k < len_sm; k++) {
+            std::size_t j = i * len_sm + k;
+            seqs_[j] = seq_;
+            cs_[j] = cs[i];
+            ns_[j] = ns[i];
+            sm_[j] = smoothings[k];
+            lmda_[j] = measures[j].lmda;
+            sgma_[j] = measures[j].sgma;
+            pmi_[j] = measures[j].pmi;
+            logratio_[j] = measures[j].logratio;
+            chi2_[j] = measures[j].chi2;
+            lfmd_[j] = measures[j].lfmd;
+            ifault[j] = measures[j].ifault;
+        }
+    }
+    std::vector<int> iwarning(3, 0);
+    warn_ifault(ifault, iwarning, warningR);
+    
+    DataFrame output_ = DataFrame::create(_["collocation"] = seqs_,
+                                          _["count"] = cs_,
+                                          _["length"] = ns_,
+                                          _["smoothing"] = sm_,
+                                          _["method"] = lmda_,
+                                          _["sigma"] = sgma_,
+                                          _["pmi"] = pmi_,
+                                          _["G2"] = logratio_,
+                                          _["chi2"] = chi2_,
+                                          _["LFMD"] = lfmd_,
+                                          _["stringsAsFactors"] = false);
+    return output_;
+}
+
+// estimate a candidate in a chunk and keep its observed counts
+template <std::size_t N>
+void estimates_chunk(std::size_t i,
+                     const std::vector<std::size_t> &index,
+                     const Sequences &sequences,
+                     ColumnChunk &chunk,
+                     const std::string &method,
+                     const double smoothing){
+    
+    const Ngram &seq = sequences.seqs_np[index[i]];
+    std::size_t g = seq[N];
+    Table<N> counts_bit, ec;
+    counts_bit.fill(smoothing);
+    count_table<N>(seq, sequences.seqs, sequences.cs, 
+                   sequences.starts[g], sequences.starts[g + 1], counts_bit);
+    chunk.measures[i] = score<N>(counts_bit, ec, method);
+    if (!chunk.cells.empty())
+        std::copy(counts_bit.begin(), counts_bit.end(), chunk.cells.begin() + (i << N));
+}
+
+template <std::size_t N>
+struct estimates_chunk_mt : public Worker{
+    
+    const std::vector<std::size_t> &index;
+    const Sequences &sequences;
+    ColumnChunk &chunk;
+    const std::string &method;
+    const double smoothing;
+    
+    estimates_chunk_mt(const std::vector<std::size_t> &index_, const Sequences &sequences_, 
+                       ColumnChunk &chunk_, const std::string &method_, const double smoothing_):
+        index(index_), sequences(sequences_), chunk(chunk_), method(method_), smoothing(smoothing_){}
+    
+    void operator()(std::size_t begin, std::size_t end){
+        for (std::size_t i = begin; i < end; i++) {
+            estimates_chunk<N>(i, index, sequences, chunk, method, smoothing);
+        }
+    }
+};
+
+// estimate the candidates of the same size in chunks and write each chunk to the file,
+// so that only a chunk of the results is in memory
+template <std::size_t N>
+void write_size(const std::vector<std::size_t> &index, const Sequences &sequences,
+                ColumnWriter &writer, const bool cells, const std::string &method,
+                const double smoothing, std::vector<int> &iwarning, Progress &progress){
+    
+    ColumnChunk chunk;
+    std::vector<std::size_t> index_chunk;
+    for (std::size_t b = 0; b < index.size(); b += COLUMNS_CHUNK_ROWS) {
+        if (is_interrupted()) {
+            progress.cancelled = true;
+            break;
+        }
+        std::size_t e = std::min(b + COLUMNS_CHUNK_ROWS, index.size());
+        index_chunk.assign(index.begin() + b, index.begin() + e);
+        std::size_t len = index_chunk.size();
+        chunk.ngrams.resize(len * N);
+        chunk.cs.resize(len);
+        chunk.measures.assign(len, Measures());
+        chunk.cells.assign(cells ? len << N : 0, 0.0);
+        for (std::size_t i = 0; i < len; i++) {
+            const Ngram &seq = sequences.seqs_np[index_chunk[i]];
+            std::copy(seq.begin(), seq.begin() + N, chunk.ngrams.begin() + i * N);
+            chunk.cs[i] = sequences.cs_np[index_chunk[i]];
+        }
+#if QUANTEDA_USE_TBB
+        estimates_chunk_mt<N> estimate_mt(index_chunk, sequences, chunk, method, smoothing);
+        parallelFor(0, len, estimate_mt);
+#else
+        for (std::size_t i = 0; i < len; i++) {
+            estimates_chunk<N>(i, index_chunk, sequences, chunk, method, smoothing);
+        }
+#endif
+        writer.write(chunk, N);
         
+        IntParams ifault(len);
+        for (std::size_t i = 0; i < len; i++) ifault[i] = chunk.measures[i].ifault;
+        warn_ifault(ifault, iwarning, warningR);
+        if (progress.verbose)
+            Rcout << "\rWriting size " << N << ": " << (100 * e / index.size()) << "%" << std::flush;
+    }
+    if (progress.verbose && !index.empty()) Rcout << std::endl;
+}
+
+typedef void (*WriteSize)(const std::vector<std::size_t> &, const Sequences &, 
+                          ColumnWriter &, const bool, const std::string &, 
+                          const double, std::vector<int> &, Progress &);
+
+// instances of write_size() indexed by the size of collocations
+const WriteSize write_sizes[COLLOCATIONS_MAX_SIZE + 1] = {
+    NULL, NULL, write_size<2>, write_size<3>, write_size<4>,
+    write_size<5>, write_size<6>, write_size<7>, write_size<8>
+};
+
+/* 
+ * This funciton estimate the strength of association like qatd_cpp_collocations_dev()
+ * but streams the results to a columnar binary file (see collocations_io.h) instead 
+ * of returning them, so that the full result is never constructed in memory.
+ * Collocations that appear less than count_min are not written.
+ * @used write_collocationsdev()
+ * @param texts_ tokens object
+ * @param count_min sequences appear less than this are ignored
+ * @param method 
+ * @param smoothing
+ * @param ignores_ ids of types that cannot be part of collocations (e.g. punctuation)
+ * @param file path to the file, which is overwritten
+ * @param cells if true, observed counts of the cells are also written
+ * @param verbose report progress of counting and writing
+ * @return the number of collocations written. If the user interrupts, the chunks
+ * written so far remain readable.
+ */
+
+// [[Rcpp::export]]
+double qatd_cpp_collocations_write(const List &texts_,
+                                   const CharacterVector &types_,
+                                   const unsigned int count_min,
+                                   const IntegerVector sizes_,
+                                   const std::string method,
+                                   const double smoothing,
+                                   const IntegerVector ignores_,
+                                   const std::string file,
+                                   const bool cells,
+                                   const bool verbose){
+    
+    Texts texts = as<Texts>(texts_);
+    std::vector<unsigned int> sizes = as< std::vector<unsigned int> >(sizes_);
+    check_sizes(sizes);
+    std::vector<bool> mask = make_mask(ignores_, types_.size());
+    std::vector<unsigned int> groups(texts.size(), 0);
+    
+    std::size_t len_tokens = 0;
+    for (std::size_t h = 0; h < texts.size(); h++) len_tokens += texts[h].size();
+    UniqueTexts unique;
+    unique_texts(texts, groups, mask, count_min, len_tokens >= COLLOCATIONS_COMPACT_MIN, unique);
+    if (unique.is_compact) Texts().swap(texts);
+    
+    ColumnWriter writer(file, types_, cells);
+    std::vector<int> iwarning(3, 0);
+    Progress progress(verbose);
+    double len_rows = 0;
+    for (std::size_t m = 0; m < sizes.size(); m++) {
+        Sequences sequences;
+        sequences_size(texts, groups, 1, unique, sizes[m], 0, sequences, progress);
+        if (progress.cancelled) break;
         
-        double total_counts = 0.0;
-        std::size_t len_noPadding = 0;
-        for (auto it = counts_seq.begin(); it != counts_seq.end(); ++it) {
-            seqs.push_back(it -> first);
-            cs.push_back(it -> second);
-            total_counts += it -> second;
-            if (std::find(it -> first.begin() , it -> first.begin() + it -> first.size(), 0) == it -> first.begin() + it -> first.size()) 
-            {
-                seqs_np.push_back(it -> first);
-                cs_np.push_back(it -> second);
-                seqs_all.push_back(it -> first);
-                cs_all.push_back(it -> second);
-                ns_all.push_back(it -> first.size());
-                len_noPadding ++;
+        std::vector<std::size_t> index;
+        for (std::size_t i = 0; i < sequences.seqs_np.size(); i++) {
+            if (sequences.cs_np[i] >= count_min) index.push_back(i);
+        }
+        write_sizes[sizes[m]](index, sequences, writer, cells, method, smoothing, iwarning, progress);
+        if (progress.cancelled) break;
+        len_rows += index.size();
+    }
+    writer.close();
+    if (progress.cancelled) throw internal::InterruptedException();
+    return len_rows;
+}
+
+// format observed counts of cells in the same way as join_counts()
+std::string join_cells(const char *p, const std::size_t len){
+    std::ostringstream out;
+    out << std::setprecision(1) << std::fixed << std::showpoint;
+    for (std::size_t j = 0; j < len; j++) {
+        double value;
+        std::memcpy(&value, p + j * sizeof(double), sizeof(double));
+        if (j > 0) out << '_';
+        out << value;
+    }
+    return out.str();
+}
+
+// copy values from a mapped column, which may not be aligned
+template <typename T, typename V>
+void append_column(const char *p, const std::size_t len, V &values){
+    for (std::size_t i = 0; i < len; i++) {
+        T value;
+        std::memcpy(&value, p + i * sizeof(T), sizeof(T));
+        values.push_back(value);
+    }
+}
+
+/* 
+ * This funciton reads a file written by qatd_cpp_collocations_write() through a 
+ * memory map and returns the collocations as a data.frame.
+ * @used read_collocationsdev()
+ * @param file path to the file
+ */
+
+// [[Rcpp::export]]
+DataFrame qatd_cpp_collocations_read(const std::string file){
+    
+    MappedFile mapped(file);
+    ColumnCursor cursor(mapped);
+    if (std::memcmp(cursor.skip(sizeof(COLUMNS_MAGIC)), COLUMNS_MAGIC, sizeof(COLUMNS_MAGIC)) != 0)
+        throw std::range_error("Invalid file of collocations");
+    if (cursor.get<uint32_t>() != COLUMNS_VERSION)
+        throw std::range_error("Unsupported version of the file");
+    
+    std::vector<Column> columns(cursor.get<uint32_t>());
+    for (std::size_t j = 0; j < columns.size(); j++) {
+        columns[j].type = cursor.get<uint8_t>();
+        columns[j].shape = cursor.get<uint8_t>();
+        uint16_t len_name = cursor.get<uint16_t>();
+        columns[j].name.assign(cursor.skip(len_name), len_name);
+    }
+    bool cells = columns.size() > 0 && columns.back().name == "cells";
+    std::vector<Column> columns_known = make_columns(cells);
+    if (columns.size() != columns_known.size())
+        throw std::range_error("Unsupported columns of the file");
+    for (std::size_t j = 0; j < columns.size(); j++) {
+        if (columns[j].name != columns_known[j].name || columns[j].type != columns_known[j].type ||
+            columns[j].shape != columns_known[j].shape)
+            throw std::range_error("Unsupported columns of the file");
+    }
+    
+    uint64_t len_types = cursor.get<uint64_t>();
+    if (len_types > cursor.remaining() / sizeof(uint32_t)) // each type has at least its length
+        throw std::range_error("Invalid or truncated file");
+    CharacterVector types_(len_types);
+    for (std::size_t g = 0; g < len_types; g++) {
+        uint32_t len_type = cursor.get<uint32_t>();
+        types_[g] = String(std::string(cursor.skip(len_type), len_type), CE_UTF8);
+    }
+    
+    std::vector<String> seqs;
+    std::vector<double> cs; // counts may not fit in Count of the build that reads them
+    std::vector<int> ns;
+    std::vector< std::vector<double> > values(6); // lambda, sigma, G2, chi2, pmi, LFMD
+    std::vector<std::string> ob;
+    while (!cursor.done()) {
+        std::size_t size = cursor.get<uint32_t>();
+        uint64_t len = cursor.get<uint64_t>();
+        if (size < 2 || COLLOCATIONS_MAX_SIZE < size)
+            throw std::range_error("Invalid file of collocations");
+        const char *p_seqs = cursor.skip(len, size * sizeof(uint32_t));
+        for (std::size_t i = 0; i < len; i++) {
+            Ngram seq;
+            append_column<uint32_t>(p_seqs + i * size * sizeof(uint32_t), size, seq);
+            for (std::size_t k = 0; k < size; k++) {
+                if (seq[k] < 1 || len_types < seq[k])
+                    throw std::range_error("Invalid file of collocations");
             }
+            seqs.push_back(join_strings(seq, types_, " "));
+            ns.push_back(size);
         }
-        
-        //output counts;
-        StringParams ob_n(len_noPadding);
-        StringParams exp_n(len_noPadding);
-        
-        // adjust total_counts of MW 
-        total_counts += 4 * smoothing;
-        
-        // Estimate significance of the sequences
-        DoubleParams sgma(len_noPadding);
-        DoubleParams lmda(len_noPadding);
-        DoubleParams dice(len_noPadding);
-        DoubleParams pmi(len_noPadding);
-        DoubleParams logratio(len_noPadding);
-        DoubleParams chi2(len_noPadding);
-        DoubleParams gensim(len_noPadding);
-        DoubleParams lfmd(len_noPadding);
-        IntParams ifault(len_noPadding, 0);
-        //dev::start_timer("Estimate", timer);
+        append_column<uint64_t>(cursor.skip(len, sizeof(uint64_t)), len, cs);
+        for (std::size_t k = 0; k < values.size(); k++) {
+            append_column<double>(cursor.skip(len, sizeof(double)), len, values[k]);
+        }
+        if (cells) {
+            std::size_t len_cells = (std::size_t)1 << size;
+            const char *p_cells = cursor.skip(len, len_cells * sizeof(double));
+            for (std::size_t i = 0; i < len; i++) {
+                ob.push_back(join_cells(p_cells + i * len_cells * sizeof(double), len_cells));
+            }
+        }
+    }
+    
+    CharacterVector seqs_(seqs.begin(), seqs.end());
+    if (cells) {
+        return DataFrame::create(_["collocation"] = seqs_,
+                                 _["count"] = as<NumericVector>(wrap(cs)),
+                                 _["length"] = as<NumericVector>(wrap(ns)),
+                                 _["lambda"] = as<NumericVector>(wrap(values[0])),
+                                 _["sigma"] = as<NumericVector>(wrap(values[1])),
+                                 _["G2"] = as<NumericVector>(wrap(values[2])),
+                                 _["chi2"] = as<NumericVector>(wrap(values[3])),
+                                 _["pmi"] = as<NumericVector>(wrap(values[4])),
+                                 _["LFMD"] = as<NumericVector>(wrap(values[5])),
+                                 _["observed_counts"] = ob,
+                                 _["stringsAsFactors"] = false);
+    } else {
+        return DataFrame::create(_["collocation"] = seqs_,
+                                 _["count"] = as<NumericVector>(wrap(cs)),
+                                 _["length"] = as<NumericVector>(wrap(ns)),
+                                 _["lambda"] = as<NumericVector>(wrap(values[0])),
+                                 _["sigma"] = as<NumericVector>(wrap(values[1])),
+                                 _["G2"] = as<NumericVector>(wrap(values[2])),
+                                 _["chi2"] = as<NumericVector>(wrap(values[3])),
+                                 _["pmi"] = as<NumericVector>(wrap(values[4])),
+                                 _["LFMD"] = as<NumericVector>(wrap(values[5])),
+                                 _["stringsAsFactors"] = false);
+    }
+}
+
+// quantile of sorted values by linear interpolation (type 7 in R)
+inline double quantile_sorted(const std::vector<double> &values, const double prob){
+    if (values.empty()) return NA_REAL;
+    double h = (values.size() - 1) * prob;
+    std::size_t l = std::floor(h);
+    if (l + 1 >= values.size()) return values.back();
+    return values[l] + (h - l) * (values[l + 1] - values[l]);
+}
+
+// tables of the documents in which a candidate matches at least one position, and 
+// the scores of replicates; reused for all the candidates estimated by a thread
+template <std::size_t N>
+struct BootBuffer {
+    std::vector<std::size_t> docs;
+    std::vector< Table<N> > tables;
+    std::vector<double> zs_rep, g2s_rep;
+};
+
+// estimate a candidate in the full data and in bootstrap replicates, which are 
+// produced by reweighting the tables of documents. The table of a document in which
+// the candidate matches no position has only the total count in the first cell, so 
+// such documents are included through the weighted totals of replicates.
+template <std::size_t N>
+void estimates_boot(std::size_t i,
+                    const VecNgrams &cands,
+                    const Sequences &sequences,
+                    const std::vector<double> &weights, // documents by replicates
+                    const std::vector<double> &totals,  // weighted totals of replicates
+                    const std::vector<double> &probs,
+                    CountParams &cs,
+                    DoubleParams &zs,
+                    DoubleParams &g2s,
+                    DoubleParams &zs_q,
+                    DoubleParams &g2s_q,
+                    IntParams &ifault,
+                    const std::string &method,
+                    const double smoothing,
+                    BootBuffer<N> &buffer){
+    
+    const std::size_t len_docs = sequences.starts.size() - 1;
+    const std::size_t len_reps = totals.size();
+    const std::size_t csize = 1 << N;
+    
+    // raw tables of documents are counted only once
+    buffer.docs.clear();
+    buffer.tables.clear();
+    Table<N> counts_bit, table, ec;
+    counts_bit.fill(smoothing);
+    for (std::size_t d = 0; d < len_docs; d++) {
+        table.fill(0.0);
+        count_table<N>(cands[i], sequences.seqs, sequences.cs, 
+                       sequences.starts[d], sequences.starts[d + 1], table);
+        bool match = false;
+        for (std::size_t b = 0; b < csize; b++) {
+            counts_bit[b] += table[b];
+            if (b > 0 && table[b] > 0) match = true;
+        }
+        if (match) {
+            buffer.docs.push_back(d);
+            buffer.tables.push_back(table);
+        }
+    }
+    cs[i] = (Count)(counts_bit[csize - 1] - smoothing);
+    Measures m = score<N>(counts_bit, ec, method);
+    zs[i] = m.lmda / m.sgma;
+    g2s[i] = m.logratio;
+    ifault[i] = m.ifault;
+    
+    std::vector<double> &zs_rep = buffer.zs_rep;
+    std::vector<double> &g2s_rep = buffer.g2s_rep;
+    zs_rep.resize(len_reps);
+    g2s_rep.resize(len_reps);
+    for (std::size_t r = 0; r < len_reps; r++) {
+        counts_bit.fill(smoothing);
+        counts_bit[0] += totals[r];
+        for (std::size_t k = 0; k < buffer.docs.size(); k++) {
+            double w = weights[r * len_docs + buffer.docs[k]];
+            if (w == 0) continue;
+            const Table<N> &t = buffer.tables[k];
+            for (std::size_t b = 1; b < csize; b++) {
+                counts_bit[b] += w * t[b];
+                counts_bit[0] -= w * t[b]; // moved from the first cell of the total
+            }
+        }
+        m = score<N>(counts_bit, ec, method);
+        zs_rep[r] = m.lmda / m.sgma;
+        g2s_rep[r] = m.logratio;
+    }
+    std::sort(zs_rep.begin(), zs_rep.end());
+    std::sort(g2s_rep.begin(), g2s_rep.end());
+    for (std::size_t p = 0; p < probs.size(); p++) {
+        zs_q[i * probs.size() + p] = quantile_sorted(zs_rep, probs[p]);
+        g2s_q[i * probs.size() + p] = quantile_sorted(g2s_rep, probs[p]);
+    }
+}
+
+template <std::size_t N>
+struct estimates_boot_mt : public Worker{
+    
+    const VecNgrams &cands;
+    const Sequences &sequences;
+    const std::vector<double> &weights;
+    const std::vector<double> &totals;
+    const std::vector<double> &probs;
+    CountParams &cs;
+    DoubleParams &zs;
+    DoubleParams &g2s;
+    DoubleParams &zs_q;
+    DoubleParams &g2s_q;
+    IntParams &ifault;
+    const std::string &method;
+    const double smoothing;
+    
+    estimates_boot_mt(const VecNgrams &cands_, const Sequences &sequences_, const std::vector<double> &weights_,
+                      const std::vector<double> &totals_, const std::vector<double> &probs_, 
+                      CountParams &cs_, DoubleParams &zs_, DoubleParams &g2s_,
+                      DoubleParams &zs_q_, DoubleParams &g2s_q_, IntParams &ifault_, 
+                      const std::string &method_, const double smoothing_):
+        cands(cands_), sequences(sequences_), weights(weights_), totals(totals_), probs(probs_), 
+        cs(cs_), zs(zs_), g2s(g2s_), zs_q(zs_q_), g2s_q(g2s_q_), ifault(ifault_), 
+        method(method_), smoothing(smoothing_){}
+    
+    void operator()(std::size_t begin, std::size_t end){
+        BootBuffer<N> buffer;
+        for (std::size_t i = begin; i < end; i++) {
+            estimates_boot<N>(i, cands, sequences, weights, totals, probs, cs, zs, g2s, zs_q, g2s_q, ifault, 
+                              method, smoothing, buffer);
+        }
+    }
+};
+
+// estimate all the candidates of the same size in bootstrap replicates
+template <std::size_t N>
+void boot_size(const VecNgrams &cands, const Sequences &sequences, const std::vector<double> &weights,
+               const std::vector<double> &probs, CountParams &cs, DoubleParams &zs, DoubleParams &g2s,
+               DoubleParams &zs_q, DoubleParams &g2s_q, IntParams &ifault, 
+               const std::string &method, const double smoothing){
+    
+    // weighted total counts of sequences in replicates, shared by all the candidates
+    const std::size_t len_docs = sequences.starts.size() - 1;
+    const std::size_t len_reps = len_docs ? weights.size() / len_docs : 0;
+    std::vector<double> totals(len_reps, 0.0);
+    for (std::size_t d = 0; d < len_docs; d++) {
+        double total = 0;
+        for (std::size_t j = sequences.starts[d]; j < sequences.starts[d + 1]; j++)
+            total += sequences.cs[j];
+        if (total == 0) continue;
+        for (std::size_t r = 0; r < len_reps; r++)
+            totals[r] += weights[r * len_docs + d] * total;
+    }
+    
 #if QUANTEDA_USE_TBB
-        estimates_mt estimate_mt(seqs_np, cs_np, seqs, cs, sgma, lmda, dice, pmi, logratio, chi2, gensim, lfmd, ifault, method, count_min, total_counts, smoothing, ob_n, exp_n);
-        parallelFor(0, seqs_np.size(), estimate_mt);
+    estimates_boot_mt<N> estimate_mt(cands, sequences, weights, totals, probs, cs, zs, g2s, zs_q, g2s_q, ifault, 
+                                     method, smoothing);
+    parallelFor(0, cands.size(), estimate_mt);
 #else
-        for (std::size_t i = 0; i < seqs_np.size(); i++) {
-            //std::vector<double> count_bit(std::pow(2, mw_len), smoothing);
-            estimates(i, seqs_np, cs_np, seqs, cs, sgma, lmda, dice, pmi, logratio, chi2, gensim, lfmd, ifault, method, count_min, total_counts, smoothing, ob_n, exp_n);
-        }
+    BootBuffer<N> buffer;
+    for (std::size_t i = 0; i < cands.size(); i++) {
+        estimates_boot<N>(i, cands, sequences, weights, totals, probs, cs, zs, g2s, zs_q, g2s_q, ifault, 
+                          method, smoothing, buffer);
+    }
 #endif
-        //output warning message
-        for (std::size_t i = 0; i < len_noPadding; i++){
-            switch(ifault[i]) {
-            case 1:
-            case 2:
-                // if (iwarning[0] == 0){
-                //     Rcout << "Warning: this should not happen" << endl; 
-                //     iwarning[0] = 1;
-                // }
-                break;
-            case 3:
-                if (iwarning[1] == 0){
-                    warningR("Warning: ipf algorithm did not converge for at least once"); 
-                    iwarning[1] = 1;
-                }
-                break;
-            case 4:
-                if (iwarning[2] == 0){
-                    warningR("Warning: incorrect specification of 'table' or 'start'"); 
-                    iwarning[2] = 1;
-                }
-                break;
-            default:
-                break;
-            }
+}
+
+typedef void (*BootSize)(const VecNgrams &, const Sequences &, const std::vector<double> &,
+                         const std::vector<double> &, CountParams &, DoubleParams &, DoubleParams &,
+                         DoubleParams &, DoubleParams &, IntParams &, const std::string &, const double);
+
+// instances of boot_size() indexed by the size of collocations
+const BootSize boot_sizes[COLLOCATIONS_MAX_SIZE + 1] = {
+    NULL, NULL, boot_size<2>, boot_size<3>, boot_size<4>,
+    boot_size<5>, boot_size<6>, boot_size<7>, boot_size<8>
+};
+
+/* 
+ * This funciton estimate quantiles of z and G2 of collocations in bootstrap replicates.
+ * Sequences are counted only once in each document, and replicates are produced by 
+ * weighting the documents' tables.
+ * @used textstat_bootcollocationsdev()
+ * @param texts_ tokens object
+ * @param count_min sequences appear less than this are ignored
+ * @param method 
+ * @param smoothing
+ * @param ignores_ ids of types that cannot be part of collocations (e.g. punctuation)
+ * @param weights_ weights of documents in replicates (documents by replicates)
+ * @param probs_ probabilities of quantiles
+ */
+
+// [[Rcpp::export]]
+List qatd_cpp_collocations_boot(const List &texts_,
+                                const CharacterVector &types_,
+                                const unsigned int count_min,
+                                const IntegerVector sizes_,
+                                const std::string method,
+                                const double smoothing,
+                                const IntegerVector ignores_,
+                                const NumericMatrix weights_,
+                                const NumericVector probs_){
+    
+    Texts texts = as<Texts>(texts_);
+    std::vector<unsigned int> sizes = as< std::vector<unsigned int> >(sizes_);
+    check_sizes(sizes);
+    std::vector<bool> mask = make_mask(ignores_, types_.size());
+    std::vector<double> probs = as< std::vector<double> >(probs_);
+    
+    if ((std::size_t)weights_.nrow() != texts.size())
+        throw std::range_error("Invalid number of rows of weights");
+    std::vector<double> weights(weights_.begin(), weights_.end());
+    
+    // documents are the groups to keep their tables separately
+    std::vector<unsigned int> groups(texts.size());
+    for (std::size_t h = 0; h < texts.size(); h++) groups[h] = h;
+    
+    Ngrams seqs;
+    std::vector<Count> cs;
+    std::vector<int> ns, ifault_all;
+    std::vector<double> zs, g2s, zs_q, g2s_q;
+    UniqueTexts unique;
+    unique_texts(texts, groups, mask, count_min, false, unique);
+    Progress progress;
+    for (std::size_t m = 0; m < sizes.size(); m++) {
+        Sequences sequences;
+        sequences_size(texts, groups, texts.size(), unique, sizes[m], 0, sequences, progress);
+        if (progress.cancelled) throw internal::InterruptedException();
+        
+        // total counts of candidates in all the documents
+        MapCounts counts_cand(sizes[m]);
+        for (std::size_t i = 0; i < sequences.seqs_np.size(); i++) {
+            Ngram cand(sequences.seqs_np[i].begin(), sequences.seqs_np[i].begin() + sizes[m]);
+            counts_cand.add(cand, sequences.cs_np[i]);
         }
+        VecNgrams cands;
+        counts_cand.for_each([&](const Ngram &cand, const Count count) {
+            if (count >= count_min) cands.push_back(cand);
+        });
         
+        std::size_t len = cands.size();
+        CountParams cs_size(len);
+        IntParams ifault(len);
+        DoubleParams zs_size(len), g2s_size(len), zs_q_size(len * probs.size()), g2s_q_size(len * probs.size());
+        boot_sizes[sizes[m]](cands, sequences, weights, probs, cs_size, zs_size, g2s_size, 
+                             zs_q_size, g2s_q_size, ifault, method, smoothing);
         
+        seqs.insert(seqs.end(), cands.begin(), cands.end());
+        cs.insert(cs.end(), cs_size.begin(), cs_size.end());
+        ns.insert(ns.end(), len, sizes[m]);
+        ifault_all.insert(ifault_all.end(), ifault.begin(), ifault.end());
+        zs.insert(zs.end(), zs_size.begin(), zs_size.end());
+        g2s.insert(g2s.end(), g2s_size.begin(), g2s_size.end());
+        zs_q.insert(zs_q.end(), zs_q_size.begin(), zs_q_size.end());
+        g2s_q.insert(g2s_q.end(), g2s_q_size.begin(), g2s_q_size.end());
+    }
+    std::vector<int> iwarning(3, 0);
+    warn_ifault(IntParams(ifault_all.begin(), ifault_all.end()), iwarning, warningR);
+    
+    std::size_t len = seqs.size();
+    CharacterVector seqs_(len);
+    NumericMatrix zs_q_(len, probs.size()), g2s_q_(len, probs.size());
+    for (std::size_t i = 0; i < len; i++) {
+        seqs_[i] = join_strings(seqs[i], types_, " ");
+        for (std::size_t p = 0; p < probs.size(); p++) {
+            zs_q_(i, p) = zs_q[i * probs.size() + p];
+            g2s_q_(i, p) = g2s_q[i * probs.size() + p];
+        }
+    }
+    
+    return List::create(_["collocation"] = seqs_,
+                        _["count"] = as_counts(cs),
+                        _["length"] = as<NumericVector>(wrap(ns)),
+                        _["z"] = as<NumericVector>(wrap(zs)),
+                        _["G2"] = as<NumericVector>(wrap(g2s)),
+                        _["z_quantile"] = zs_q_,
+                        _["G2_quantile"] = g2s_q_);
+}
+
+// replace n-grams in map_comps with ids of compounds from left to right, counting 
+// the replacements by compounds whose ids start from id_first
+void compound(Text &text,
+              const MapNgrams &map_comps,
+              const std::size_t size,
+              const IdNgram id_first,
+              std::vector<CountParam> &cs_applied){
+    
+    std::size_t len_text = text.size();
+    if (len_text < size) return; // do nothing with short or empty text
+    
+    Ngram ngram(size);
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < len_text;) {
+        if (i + size <= len_text) {
+            ngram.assign(text.begin() + i, text.begin() + i + size);
+            auto it = map_comps.find(ngram);
+            if (it != map_comps.end()) {
+                text[j++] = it -> second;
+                cs_applied[it -> second - id_first]++;
+                i += size;
+                continue;
+            }
+        }
+        text[j++] = text[i++];
+    }
+    text.resize(j);
+}
+
+struct compound_mt : public Worker{
+    
+    Texts &texts;
+    const MapNgrams &map_comps;
+    const std::size_t size;
+    const IdNgram id_first;
+    std::vector<CountParam> &cs_applied;
+    
+    compound_mt(Texts &texts_, const MapNgrams &map_comps_, const std::size_t size_, 
+                const IdNgram id_first_, std::vector<CountParam> &cs_applied_):
+        texts(texts_), map_comps(map_comps_), size(size_), id_first(id_first_), cs_applied(cs_applied_){}
+    
+    void operator()(std::size_t begin, std::size_t end){
+        for (std::size_t h = begin; h < end; h++){
+            compound(texts[h], map_comps, size, id_first, cs_applied);
+        }
+    }
+};
+
+/* 
+ * This funciton scores collocations and compounds those above the threshold in 
+ * tokens. The scoring and compounding are repeated for each of sizes_ on the 
+ * compounded tokens (e.g. bigrams and then trigrams) without returning to R.
+ * @used tokens_compound_collocationsdev()
+ * @param texts_ tokens object
+ * @param count_min sequences appear less than this are ignored
+ * @param sizes_ size of collocations in each round
+ * @param method 
+ * @param smoothing
+ * @param threshold collocations are compounded if the measure is equal or greater
+ * @param ignores_ ids of types that cannot be part of collocations (e.g. punctuation)
+ * @param delim_ concatenator of compounded types
+ * 
+ * Only collocations that are compounded at least once are returned; those above the 
+ * threshold whose tokens are taken by overlapping collocations to their left are not.
+ */
+
+// [[Rcpp::export]]
+List qatd_cpp_collocations_compound(const List &texts_,
+                                    const CharacterVector &types_,
+                                    const unsigned int count_min,
+                                    const IntegerVector sizes_,
+                                    const std::string method,
+                                    const double smoothing,
+                                    const double threshold,
+                                    const IntegerVector ignores_,
+                                    const String delim_){
+    
+    Texts texts = as<Texts>(texts_);
+    std::vector<unsigned int> sizes = as< std::vector<unsigned int> >(sizes_);
+    check_sizes(sizes);
+    std::vector<bool> mask = make_mask(ignores_, types_.size());
+    std::string delim = delim_;
+    
+    std::size_t len_types = types_.size();
+    Types types_comp; // types of compounds
+    VecNgrams seqs_comp;
+    std::vector<Count> cs_comp;
+    std::vector<int> ns_comp, rs_comp;
+    std::vector<double> ms_comp;
+    
+    //warning sign
+    std::vector<int> iwarning(3, 0);
+    std::vector<unsigned int> groups(texts.size(), 0);
+    Progress progress;
+    for (std::size_t m = 0; m < sizes.size(); m++) {
+        Collocations colls;
+        UniqueTexts unique;
+        unique_texts(texts, groups, mask, count_min, false, unique);
+        collocations_size(texts, groups, 1, unique, sizes[m], 0, count_min, method, smoothing, colls, iwarning, progress);
+        if (progress.cancelled) throw internal::InterruptedException();
         
-        //dev::stop_timer("Estimate", timer);
-        sgma_all.insert( sgma_all.end(), sgma.begin(), sgma.end() );
-        lmda_all.insert( lmda_all.end(), lmda.begin(), lmda.end() );
-        dice_all.insert( dice_all.end(), dice.begin(), dice.end() );
-        pmi_all.insert( pmi_all.end(), pmi.begin(), pmi.end() );
-        logratio_all.insert( logratio_all.end(), logratio.begin(), logratio.end() );
-        chi2_all.insert( chi2_all.end(), chi2.begin(), chi2.end() );
-        gensim_all.insert( gensim_all.end(), gensim.begin(), gensim.end() );
-        lfmd_all.insert( lfmd_all.end(), lfmd.begin(), lfmd.end() );
+        // sort selected collocations to assign ids deterministically
+        std::vector<std::size_t> selected;
+        for (std::size_t i = 0; i < colls.seqs.size(); i++) {
+            if (colls.cs[i] < count_min) continue;
+            if (select_measure(colls, i, method) >= threshold) selected.push_back(i);
+        }
+        if (selected.empty()) continue;
+        std::sort(selected.begin(), selected.end(), [&colls](std::size_t i1, std::size_t i2) {
+            return colls.seqs[i1] < colls.seqs[i2];
+        });
         
-        //output counts
-        ob_all.insert( ob_all.end(), ob_n.begin(), ob_n.end() );
-        exp_all.insert( exp_all.end(), exp_n.begin(), exp_n.end() );
+        MapNgrams map_comps;
+        map_comps.max_load_factor(GLOBAL_PATTERNS_MAX_LOAD_FACTOR);
+        IdNgram id_first = len_types + types_comp.size() + 1;
+        for (std::size_t k = 0; k < selected.size(); k++) {
+            std::size_t i = selected[k];
+            const Ngram &seq = colls.seqs[i];
+            Type type_comp;
+            for (std::size_t l = 0; l < seq.size(); l++) {
+                if (l > 0) type_comp += delim;
+                if (seq[l] <= len_types) {
+                    type_comp += as<std::string>(types_[seq[l] - 1]);
+                } else {
+                    type_comp += types_comp[seq[l] - len_types - 1];
+                }
+            }
+            types_comp.push_back(type_comp);
+            map_comps.insert(std::pair<Ngram, IdNgram>(seq, len_types + types_comp.size()));
+        }
+        mask.resize(len_types + types_comp.size() + 1, false);
         
+        std::vector<CountParam> cs_applied(selected.size(), 0);
+#if QUANTEDA_USE_TBB
+        compound_mt comp_mt(texts, map_comps, sizes[m], id_first, cs_applied);
+        parallelFor(0, texts.size(), comp_mt);
+#else
+        for (std::size_t h = 0; h < texts.size(); h++) {
+            compound(texts[h], map_comps, sizes[m], id_first, cs_applied);
+        }
+#endif
         
+        // report only the collocations that are compounded
+        for (std::size_t k = 0; k < selected.size(); k++) {
+            if (cs_applied[k] == 0) continue;
+            std::size_t i = selected[k];
+            seqs_comp.push_back(colls.seqs[i]);
+            cs_comp.push_back(colls.cs[i]);
+            ns_comp.push_back(colls.ns[i]);
+            rs_comp.push_back(m + 1);
+            ms_comp.push_back(select_measure(colls, i, method));
+        }
     }
     
-    // Convert sequences from integer to character
-    CharacterVector seqs_(seqs_all.size());
-    for (std::size_t i = 0; i < seqs_all.size(); i++) {
-        seqs_[i] = join_strings(seqs_all[i], types_, " ");
+    CharacterVector types_new_(len_types + types_comp.size());
+    for (std::size_t g = 0; g < len_types; g++) {
+        types_new_[g] = types_[g];
+    }
+    for (std::size_t g = 0; g < types_comp.size(); g++) {
+        String type_(types_comp[g]);
+        type_.set_encoding(CE_UTF8);
+        types_new_[len_types + g] = type_;
     }
     
-    DataFrame output_ = DataFrame::create(_["collocation"] = seqs_,
-                                          _["count"] = as<IntegerVector>(wrap(cs_all)),
-                                          _["length"] = as<NumericVector>(wrap(ns_all)),
-                                          _["method"] = as<NumericVector>(wrap(lmda_all)),
-                                          _["sigma"] = as<NumericVector>(wrap(sgma_all)),
-                                          _["dice"] = as<NumericVector>(wrap(dice_all)),
-                                          _["gensim"] = as<NumericVector>(wrap(gensim_all)),
-                                          _["pmi"] = as<NumericVector>(wrap(pmi_all)),
-                                          _["G2"] = as<NumericVector>(wrap(logratio_all)),
-                                          _["chi2"] = as<NumericVector>(wrap(chi2_all)),
-                                          _["LFMD"] = as<NumericVector>(wrap(lfmd_all)),
-                                          _["observed_counts"] = ob_all,
-                                          _["expected_counts"] = exp_all,
-                                          _["stringsAsFactors"] = false);
-    return output_;
+    CharacterVector seqs_(seqs_comp.size());
+    for (std::size_t i = 0; i < seqs_comp.size(); i++) {
+        seqs_[i] = join_strings(seqs_comp[i], types_new_, " ");
+    }
+    DataFrame colls_ = DataFrame::create(_["collocation"] = seqs_,
+                                         _["count"] = as_counts(cs_comp),
+                                         _["length"] = as<NumericVector>(wrap(ns_comp)),
+                                         _["round"] = as<IntegerVector>(wrap(rs_comp)),
+                                         _["measure"] = as<NumericVector>(wrap(ms_comp)),
+                                         _["stringsAsFactors"] = false);
+    
+    return List::create(_["tokens"] = as_list(texts),
+                        _["types"] = types_new_,
+                        _["collocations"] = colls_);
 }
 
-
 /***R
 toks <- tokens(data_corpus_inaugural)
 toks <- tokens_select(toks, stopwords("english"), "remove", padding = TRUE)
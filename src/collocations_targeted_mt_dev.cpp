@@ -0,0 +1,279 @@
+#include "collocations.h"
+using namespace quanteda;
+
+// candidates indexed by the type at a position
+typedef std::unordered_map<unsigned int, std::vector<unsigned int> > MapPostings;
+
+// count the cells of the candidates that match windows of a text at one or more
+// positions; the cells without matching positions are computed from the total number
+// of windows later
+void counts_targeted(const Text &text,
+                     const std::vector<MapPostings> &postings,
+                     std::vector<CountParam> &counts_cell,
+                     const std::size_t size){
+
+    std::size_t len_text = text.size();
+    if (len_text < size) return; // do nothing with short or empty text
+
+    const std::size_t csize = 1 << size;
+    std::vector< std::pair<unsigned int, int> > hits;
+    for (std::size_t i = 0; i + size <= len_text; i++) {
+        hits.clear();
+        for (std::size_t k = 0; k < size; k++) {
+            auto it = postings[k].find(text[i + k]);
+            if (it == postings[k].end()) continue;
+            for (std::size_t c = 0; c < it -> second.size(); c++) {
+                hits.push_back(std::make_pair(it -> second[c], 1 << k));
+            }
+        }
+        if (hits.empty()) continue;
+        std::sort(hits.begin(), hits.end());
+        std::size_t c = hits[0].first;
+        int bit = 0;
+        for (std::size_t h = 0; h < hits.size(); h++) {
+            if (hits[h].first != c) {
+                counts_cell[c * csize + bit]++;
+                c = hits[h].first;
+                bit = 0;
+            }
+            bit |= hits[h].second;
+        }
+        counts_cell[c * csize + bit]++;
+    }
+}
+
+struct counts_targeted_mt : public Worker{
+
+    Texts &texts;
+    const std::vector<MapPostings> &postings;
+    std::vector<CountParam> &counts_cell;
+    const std::size_t size;
+
+    counts_targeted_mt(Texts &texts_, const std::vector<MapPostings> &postings_,
+                       std::vector<CountParam> &counts_cell_, const std::size_t size_):
+        texts(texts_), postings(postings_), counts_cell(counts_cell_), size(size_){}
+
+    void operator()(std::size_t begin, std::size_t end){
+        for (std::size_t h = begin; h < end; h++){
+            counts_targeted(texts[h], postings, counts_cell, size);
+        }
+    }
+};
+
+template <std::size_t N>
+void estimates_targeted(std::size_t i,
+                        const std::vector<std::size_t> &index,
+                        const std::vector<CountParam> &counts_cell,
+                        const double nwindows,
+                        std::vector<Measures> &measures,
+                        std::vector<Count> &cs,
+                        std::vector<std::string> &ob_n,
+                        std::vector<std::string> &exp_n,
+                        const std::string &method,
+                        const double smoothing){
+
+    const std::size_t csize = 1 << N;
+    Table<N> counts_bit;
+    double nmatched = 0.0;
+    for (std::size_t b = 1; b < csize; b++) {
+        counts_bit[b] = counts_cell[i * csize + b];
+        nmatched += counts_bit[b];
+    }
+    counts_bit[0] = nwindows - nmatched;
+    for (std::size_t b = 0; b < csize; b++) {
+        counts_bit[b] += smoothing;
+    }
+
+    std::size_t g = index[i];
+    Table<N> ec;
+    measures[g] = score<N>(counts_bit, ec, method);
+    cs[g] = counts_cell[i * csize + csize - 1];
+    ob_n[g] = join_counts<N>(counts_bit);
+    exp_n[g] = join_counts<N>(ec);
+}
+
+template <std::size_t N>
+struct estimates_targeted_mt : public Worker{
+
+    const std::vector<std::size_t> &index;
+    const std::vector<CountParam> &counts_cell;
+    const double nwindows;
+    std::vector<Measures> &measures;
+    std::vector<Count> &cs;
+    std::vector<std::string> &ob_n;
+    std::vector<std::string> &exp_n;
+    const std::string &method;
+    const double smoothing;
+
+    estimates_targeted_mt(const std::vector<std::size_t> &index_, const std::vector<CountParam> &counts_cell_,
+                          const double nwindows_, std::vector<Measures> &measures_, std::vector<Count> &cs_,
+                          std::vector<std::string> &ob_n_, std::vector<std::string> &exp_n_,
+                          const std::string &method_, const double smoothing_):
+        index(index_), counts_cell(counts_cell_), nwindows(nwindows_), measures(measures_), cs(cs_),
+        ob_n(ob_n_), exp_n(exp_n_), method(method_), smoothing(smoothing_){}
+
+    void operator()(std::size_t begin, std::size_t end){
+        for (std::size_t i = begin; i < end; i++) {
+            estimates_targeted<N>(i, index, counts_cell, nwindows, measures, cs, ob_n, exp_n, method, smoothing);
+        }
+    }
+};
+
+// count and estimate all the candidates of the same size
+template <std::size_t N>
+void targeted_size(Texts &texts, const Ngrams &cands, const std::vector<std::size_t> &index,
+                   std::vector<Measures> &measures, std::vector<Count> &cs,
+                   std::vector<std::string> &ob_n, std::vector<std::string> &exp_n,
+                   const std::string &method, const double smoothing, Progress &progress){
+
+    // index candidates by their types at each position
+    std::vector<MapPostings> postings(N);
+    for (std::size_t i = 0; i < index.size(); i++) {
+        const Ngram &cand = cands[index[i]];
+        for (std::size_t k = 0; k < N; k++) {
+            postings[k][cand[k]].push_back(i);
+        }
+    }
+
+    double nwindows = 0.0;
+    for (std::size_t h = 0; h < texts.size(); h++) {
+        if (texts[h].size() >= N) nwindows += texts[h].size() - N + 1;
+    }
+
+    std::vector<CountParam> counts_cell(index.size() * (1 << N));
+    counts_targeted_mt count_mt(texts, postings, counts_cell, N);
+    if (!run_chunks(count_mt, 0, texts.size(), progress, "Counting size " + std::to_string(N))) return;
+    estimates_targeted_mt<N> estimate_mt(index, counts_cell, nwindows, measures, cs, ob_n, exp_n, method, smoothing);
+    run_chunks(estimate_mt, 0, index.size(), progress, "Estimating size " + std::to_string(N));
+}
+
+typedef void (*TargetedSize)(Texts &, const Ngrams &, const std::vector<std::size_t> &,
+                             std::vector<Measures> &, std::vector<Count> &,
+                             std::vector<std::string> &, std::vector<std::string> &,
+                             const std::string &, const double, Progress &);
+
+// instances of targeted_size() indexed by the size of collocations
+const TargetedSize targeted_sizes[COLLOCATIONS_MAX_SIZE + 1] = {
+    NULL, NULL, targeted_size<2>, targeted_size<3>, targeted_size<4>,
+    targeted_size<5>, targeted_size<6>, targeted_size<7>, targeted_size<8>
+};
+
+Function warningR_targeted("warning");
+
+/*
+ * This funciton estimate the strength of association of candidates supplied by users.
+ * Only the cells of the candidates are counted, so that the full table of n-grams
+ * is not constructed.
+ * @used textstat_collocationsdev()
+ * @param texts_ tokens object
+ * @param candidates_ list of type ids of candidates
+ * @param method
+ * @param smoothing
+ * @param ignores_ ids of types that cannot be part of collocations (e.g. punctuation)
+ * @param verbose report progress of counting and estimation
+ * 
+ * If the user interrupts, candidates of the completed sizes are returned with an
+ * "interrupted" attribute.
+ */
+
+// [[Rcpp::export]]
+DataFrame qatd_cpp_collocations_targeted(const List &texts_,
+                                         const CharacterVector &types_,
+                                         const List &candidates_,
+                                         const std::string method,
+                                         const double smoothing,
+                                         const IntegerVector ignores_,
+                                         const bool verbose){
+
+    Texts texts = as<Texts>(texts_);
+
+    std::vector<bool> mask = make_mask(ignores_, types_.size());
+
+    IntegerVector ids_(candidates_.size());
+    for (std::size_t g = 0; g < (std::size_t)ids_.size(); g++) ids_[g] = g;
+    MapNgrams map_cands;
+    std::vector<std::size_t> spans = register_ngrams(candidates_, ids_, map_cands);
+
+    // group unique candidates by size and drop those that cannot be collocations
+    Ngrams cands(candidates_.size());
+    std::vector< std::vector<std::size_t> > index(COLLOCATIONS_MAX_SIZE + 1);
+    for (auto it = map_cands.begin(); it != map_cands.end(); ++it) {
+        const Ngram &cand = it -> first;
+        std::size_t g = it -> second;
+        if (cand.size() < 2 || COLLOCATIONS_MAX_SIZE < cand.size()) continue;
+        bool valid = true;
+        for (std::size_t k = 0; k < cand.size(); k++) {
+            if (cand[k] > types_.size() || mask[cand[k]]) valid = false;
+        }
+        if (!valid) continue;
+        cands[g] = cand;
+        index[cand.size()].push_back(g);
+    }
+
+    std::vector<Measures> measures(cands.size());
+    std::vector<Count> cs(cands.size(), 0);
+    std::vector<std::string> ob_n(cands.size()), exp_n(cands.size());
+    std::vector<bool> completed(COLLOCATIONS_MAX_SIZE + 1, false);
+    Progress progress(verbose);
+    for (std::size_t n = 0; n < spans.size(); n++) {
+        std::size_t len = spans[n];
+        if (len < 2 || COLLOCATIONS_MAX_SIZE < len || index[len].empty()) continue;
+        std::sort(index[len].begin(), index[len].end());
+        targeted_sizes[len](texts, cands, index[len], measures, cs, ob_n, exp_n, method, smoothing, progress);
+        if (progress.cancelled) break;
+        completed[len] = true;
+    }
+
+    // output in the original order of candidates, dropping sizes not completed
+    for (std::size_t g = 0; g < cands.size(); g++) {
+        if (!completed[cands[g].size()]) cands[g].clear();
+    }
+    std::size_t len_out = 0;
+    for (std::size_t g = 0; g < cands.size(); g++) {
+        if (!cands[g].empty()) len_out++;
+    }
+    CharacterVector seqs_(len_out);
+    CountVector cs_(len_out);
+    NumericVector ns_(len_out), lmda_(len_out), sgma_(len_out), dice_(len_out), gensim_(len_out),
+                  pmi_(len_out), logratio_(len_out), chi2_(len_out), lfmd_(len_out);
+    CharacterVector ob_(len_out), exp_(len_out);
+    IntParams ifault(len_out);
+    std::size_t j = 0;
+    for (std::size_t g = 0; g < cands.size(); g++) {
+        if (cands[g].empty()) continue;
+        seqs_[j] = join_strings(cands[g], types_, " ");
+        cs_[j] = cs[g];
+        ns_[j] = cands[g].size();
+        lmda_[j] = measures[g].lmda;
+        sgma_[j] = measures[g].sgma;
+        dice_[j] = measures[g].dice;
+        gensim_[j] = measures[g].gensim;
+        pmi_[j] = measures[g].pmi;
+        logratio_[j] = measures[g].logratio;
+        chi2_[j] = measures[g].chi2;
+        lfmd_[j] = measures[g].lfmd;
+        ob_[j] = ob_n[g];
+        exp_[j] = exp_n[g];
+        ifault[j] = measures[g].ifault;
+        j++;
+    }
+    std::vector<int> iwarning(3, 0);
+    warn_ifault(ifault, iwarning, warningR_targeted);
+
+    DataFrame output_ = DataFrame::create(_["collocation"] = seqs_,
+                                          _["count"] = cs_,
+                                          _["length"] = ns_,
+                                          _["method"] = lmda_,
+                                          _["sigma"] = sgma_,
+                                          _["dice"] = dice_,
+                                          _["gensim"] = gensim_,
+                                          _["pmi"] = pmi_,
+                                          _["G2"] = logratio_,
+                                          _["chi2"] = chi2_,
+                                          _["LFMD"] = lfmd_,
+                                          _["observed_counts"] = ob_,
+                                          _["expected_counts"] = exp_,
+                                          _["stringsAsFactors"] = false);
+    if (progress.cancelled) output_.attr("interrupted") = true;
+    return output_;
+}
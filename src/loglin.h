@@ -24,7 +24,7 @@ All parameters are assumed valid without test.
 The larger table is X and the smaller one is Y.
 */
     
-void collap(int nvar, double *x, double *y, int locy, int *dim, int *config)
+static void collap(int nvar, double *x, double *y, int locy, int *dim, int *config)
 {
     int i, j, k, l, n, locu, size[nvar + 1], coord[nvar];
     
@@ -85,7 +85,7 @@ void collap(int nvar, double *x, double *y, int locy, int *dim, int *config)
 /* Makes proportional adjustment corresponding to CONFIG.
 All parameters are assumed valid without test.
 */
-void adjust(int nvar, double *x, double *y, double *z, int *locz,
+static void adjust(int nvar, double *x, double *y, double *z, int *locz,
             int *dim, int *config, double *d)
 {
     int i, j, k, l, n, size[nvar + 1], coord[nvar];